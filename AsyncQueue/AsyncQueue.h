@@ -0,0 +1,55 @@
+#ifndef ASYNC_QUEUE_H
+#define ASYNC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+// ****************************************
+// *   Single producer, single consumer   *
+// ****************************************
+
+// commands waiting for the worker, a power of two
+#ifndef ASYNC_QUEUE_SIZE
+#define ASYNC_QUEUE_SIZE 8
+#endif
+
+// fixed ring of slots without locks: one context fills the slots, another one empties them
+// the slots are reused in place, so what they own (e.g. an arg_arena) is allocated once
+template<typename T, size_t N>
+class spsc_queue {
+        static_assert(N > 0 && (N & (N - 1)) == 0, "the size of the queue must be a power of two");
+
+    public:
+        spsc_queue() : head(0), tail(0) {}
+
+        // producer: the slot to fill, nullptr when the queue is full
+        T* producer_slot() {
+            size_t t = tail.load(memory_order_relaxed);
+            if (t - head.load(memory_order_acquire) == N) return nullptr;
+            return &slots[t & (N - 1)];
+        }
+
+        // producer: hand the filled slot to the consumer
+        void publish() { tail.store(tail.load(memory_order_relaxed) + 1, memory_order_release); }
+
+        // consumer: the oldest filled slot, nullptr when the queue is empty
+        T* consumer_slot() {
+            size_t h = head.load(memory_order_relaxed);
+            if (h == tail.load(memory_order_acquire)) return nullptr;
+            return &slots[h & (N - 1)];
+        }
+
+        // consumer: give the slot back to the producer
+        void release() { head.store(head.load(memory_order_relaxed) + 1, memory_order_release); }
+
+        bool empty() const { return head.load(memory_order_acquire) == tail.load(memory_order_acquire); }
+
+    private:
+        T slots[N];
+        atomic<size_t> head;    // next slot to consume
+        atomic<size_t> tail;    // next slot to produce
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "BinaryProtocol.h"
+
+#include <cstring>
+
+uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc) {
+    // one nibble at a time, 32 bytes of table instead of 512
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+    };
+    for (size_t i = 0; i < length; i++) {
+        crc = static_cast<uint16_t>((crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)]);
+        crc = static_cast<uint16_t>((crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)]);
+    }
+    return crc;
+}
+
+size_t seal_frame(uint8_t* buffer, size_t payload_size) {
+    buffer[0] = FRAME_SYNC;
+    buffer[1] = static_cast<uint8_t>(payload_size);
+    uint16_t crc = crc16(buffer + 1, payload_size + 1);
+    buffer[2 + payload_size] = static_cast<uint8_t>(crc);
+    buffer[3 + payload_size] = static_cast<uint8_t>(crc >> 8);
+    return payload_size + FRAME_OVERHEAD;
+}
+
+bool frame_reader::feed(uint8_t byte) {
+    // the frame delivered by the last call is released, then the window goes back to the front when full
+    start += consumed;
+    consumed = 0;
+    if (start == end) start = end = 0;
+    else if (end == sizeof(buffer)) {
+        memmove(buffer, buffer + start, end - start);
+        end -= start;
+        start = 0;
+    }
+    buffer[end++] = byte;
+    return next();
+}
+
+bool frame_reader::next() {
+    start += consumed;
+    consumed = 0;
+
+    while (start < end) {
+        // the bytes before a sync are noise
+        const uint8_t* sync = static_cast<const uint8_t*>(memchr(buffer + start, FRAME_SYNC, end - start));
+        if (!sync) {
+            start = end = 0;
+            return false;
+        }
+        start = sync - buffer;
+
+        if (end - start < 2) return false;
+        size_t size = buffer[start + 1] + FRAME_OVERHEAD;
+        if (end - start < size) return false;
+
+        // the crc covers the length and the payload
+        uint16_t crc = crc16(buffer + start + 1, size - 3);
+        if ((buffer[start + size - 2] | (buffer[start + size - 1] << 8)) == crc) {
+            length = buffer[start + 1];
+            consumed = size;
+            return true;
+        }
+
+        // the next frame may start inside the bytes taken by this one
+        errors++;
+        start++;
+    }
+    return false;
+}
@@ -0,0 +1,191 @@
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <TableLinker/TableLinker.h>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// ****************************************
+// *     Binary framing of the commands   *
+// ****************************************
+
+// a frame is: sync, length of the payload, payload, crc16 of the length and the payload
+// the payload is the id of the command (u16) followed by its arguments in the order of the parameters:
+//   u1, i1, c1, b1  1 byte
+//   i4, u4, f4      4 bytes
+//   i8, u8, f8      8 bytes
+//   s0              1 byte of length and the characters
+//   arrays          1 byte with the number of values and the values
+// multi-byte values are little endian, the native order of the supported targets
+#define FRAME_SYNC        0xA5
+#define FRAME_MAX_PAYLOAD 255
+#define FRAME_OVERHEAD    4   // sync, length and crc
+
+// crc16-ccitt (0x1021, starting at 0xFFFF)
+uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+
+// ****************************************
+// *     Decoding of the arguments        *
+// ****************************************
+
+// takes one argument out of 'data' into the arena, advancing 'data'
+typedef convert_result (*binary_converter)(const uint8_t*& data, const uint8_t* end, arg_arena& arena);
+
+template<typename T>
+convert_result decode_arg(const uint8_t*& data, const uint8_t* end, arg_arena& arena) {
+    if (static_cast<size_t>(end - data) < sizeof(T)) return {nullptr, CONVERT_INVALID};
+    T* ptr = arena.emplace<T>();
+    if (!ptr) return {nullptr, CONVERT_NO_SPACE};
+    memcpy(ptr, data, sizeof(T));
+    data += sizeof(T);
+    return {ptr, CONVERT_OK};
+}
+
+template<>
+inline convert_result decode_arg<bool>(const uint8_t*& data, const uint8_t* end, arg_arena& arena) {
+    if (data == end || *data > 1) return {nullptr, CONVERT_INVALID};
+    bool* ptr = arena.emplace<bool>(*data == 1);
+    if (!ptr) return {nullptr, CONVERT_NO_SPACE};
+    data++;
+    return {ptr, CONVERT_OK};
+}
+
+template<>
+inline convert_result decode_arg<string>(const uint8_t*& data, const uint8_t* end, arg_arena& arena) {
+    if (data == end || static_cast<size_t>(end - data - 1) < *data) return {nullptr, CONVERT_INVALID};
+    size_t length = *data;
+    string* ptr = arena.emplace<string>(reinterpret_cast<const char*>(data + 1), length);
+    if (!ptr) return {nullptr, CONVERT_NO_SPACE};
+    data += 1 + length;
+    return {ptr, CONVERT_OK};
+}
+
+template<typename T>
+convert_result decode_array(const uint8_t*& data, const uint8_t* end, arg_arena& arena) {
+    if (data == end || static_cast<size_t>(end - data - 1) < *data * sizeof(T)) return {nullptr, CONVERT_INVALID};
+    size_t count = *data;
+    vector<T>* ptr = arena.emplace<vector<T>>(count);
+    if (!ptr) return {nullptr, CONVERT_NO_SPACE};
+    if (count) memcpy(ptr->data(), data + 1, count * sizeof(T));
+    data += 1 + count * sizeof(T);
+    return {ptr, CONVERT_OK};
+}
+
+inline convert_result decode_unknown(const uint8_t*&, const uint8_t*, arg_arena&) { return {nullptr, CONVERT_UNKNOWN_TYPE}; }
+
+// indexed by type_tag, as type_converters
+inline constexpr binary_converter binary_converters[] = {
+    decode_arg<uint8_t>,    // TYPE_U1
+    decode_arg<int8_t>,     // TYPE_I1
+    decode_arg<int32_t>,    // TYPE_I4
+    decode_arg<uint32_t>,   // TYPE_U4
+    decode_arg<int64_t>,    // TYPE_I8
+    decode_arg<uint64_t>,   // TYPE_U8
+    decode_arg<float>,      // TYPE_F4
+    decode_arg<double>,     // TYPE_F8
+    decode_arg<char>,       // TYPE_C1
+    decode_arg<bool>,       // TYPE_B1
+    decode_arg<string>,     // TYPE_S0
+    decode_array<uint8_t>,  // TYPE_U1_ARRAY
+    decode_array<int8_t>,   // TYPE_I1_ARRAY
+    decode_array<int32_t>,  // TYPE_I4_ARRAY
+    decode_array<uint32_t>, // TYPE_U4_ARRAY
+    decode_array<int64_t>,  // TYPE_I8_ARRAY
+    decode_array<uint64_t>, // TYPE_U8_ARRAY
+    decode_array<float>,    // TYPE_F4_ARRAY
+    decode_array<double>,   // TYPE_F8_ARRAY
+    decode_unknown          // TYPE_UNKNOWN
+};
+TYPE_TABLE_CHECK(binary_converters);
+
+// ****************************************
+// *     Encoding of the frames           *
+// ****************************************
+
+// writes one value of the payload, false if it does not fit
+template<typename T>
+bool encode_arg(uint8_t*& out, const uint8_t* end, const T& value) {
+    static_assert(is_arithmetic<T>::value, "only arithmetic values and strings are encoded");
+    if (static_cast<size_t>(end - out) < sizeof(T)) return false;
+    memcpy(out, &value, sizeof(T));
+    out += sizeof(T);
+    return true;
+}
+
+inline bool encode_arg(uint8_t*& out, const uint8_t* end, string_view value) {
+    if (value.size() > 255 || static_cast<size_t>(end - out) < 1 + value.size()) return false;
+    *out++ = static_cast<uint8_t>(value.size());
+    memcpy(out, value.data(), value.size());
+    out += value.size();
+    return true;
+}
+
+template<typename T>
+bool encode_arg(uint8_t*& out, const uint8_t* end, const vector<T>& values) {
+    static_assert(is_arithmetic<T>::value, "only arrays of numbers are encoded");
+    if (values.size() > 255 || static_cast<size_t>(end - out) < 1 + values.size() * sizeof(T)) return false;
+    *out++ = static_cast<uint8_t>(values.size());
+    if (!values.empty()) memcpy(out, values.data(), values.size() * sizeof(T));
+    out += values.size() * sizeof(T);
+    return true;
+}
+
+inline bool encode_arg(uint8_t*& out, const uint8_t* end, const string& value) { return encode_arg(out, end, string_view(value)); }
+inline bool encode_arg(uint8_t*& out, const uint8_t* end, const char* value) { return encode_arg(out, end, string_view(value)); }
+
+// adds the sync, length and crc around a payload already written at buffer + 2
+size_t seal_frame(uint8_t* buffer, size_t payload_size);
+
+// builds the frame of a command in 'buffer', the values must have the parameter types
+// e.g. encode_frame(buffer, sizeof(buffer), id, int32_t(1), 2.5f, "abc")
+// returns the length of the frame, 0 if it does not fit
+template<typename... A>
+size_t encode_frame(uint8_t* buffer, size_t size, uint16_t id, const A&... values) {
+    if (size < FRAME_OVERHEAD + 2) return 0;
+    size_t room = size - FRAME_OVERHEAD < FRAME_MAX_PAYLOAD ? size - FRAME_OVERHEAD : FRAME_MAX_PAYLOAD;
+    uint8_t* out = buffer + 2;
+    const uint8_t* end = out + room;
+
+    encode_arg(out, end, id);
+    if (!(encode_arg(out, end, values) && ...)) return 0;
+    return seal_frame(buffer, out - buffer - 2);
+}
+
+// ****************************************
+// *     Reception of the frames          *
+// ****************************************
+
+// assembles frames from a stream of bytes, e.g. a serial port
+// a frame with a wrong crc is dropped and its bytes are searched for the sync of the next one
+// the bytes not yet parsed are kept, so every frame found among them is delivered by the next feeds
+class frame_reader {
+    public:
+        frame_reader() : start(0), end(0), consumed(0), length(0), errors(0) {}
+
+        // one byte received, true when it completes a frame with a valid crc
+        bool feed(uint8_t byte);
+
+        // the next frame already among the received bytes, e.g. recovered from a dropped one
+        // call it after each frame until it returns false: while (complete) { ...; complete = reader.next(); }
+        bool next();
+
+        // payload of the last complete frame, valid until the next feed
+        const uint8_t* get_payload() const { return buffer + start + 2; }
+        size_t get_payload_size() const { return length; }
+
+        // frames dropped by a wrong crc
+        uint32_t get_errors() const { return errors; }
+
+    private:
+        // received bytes from 'start' to 'end', a frame at most and what came after one delivered
+        uint8_t buffer[FRAME_MAX_PAYLOAD + FRAME_OVERHEAD];
+        size_t start;
+        size_t end;
+        size_t consumed;    // bytes of the delivered frame, released by the next feed
+        uint8_t length;
+        uint32_t errors;
+};
+
+#endif
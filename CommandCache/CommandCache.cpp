@@ -0,0 +1,69 @@
+#include "CommandCache.h"
+
+command_cache::~command_cache() {
+    delete[] entries;
+}
+
+void command_cache::resize(size_t new_capacity) {
+    delete[] entries;
+    entries = new_capacity ? new cache_entry[new_capacity] : nullptr;
+    capacity = new_capacity;
+    clear();
+    hits = 0;
+    misses = 0;
+}
+
+uint32_t command_cache::next_tick() {
+    if (++tick == 0) {
+        for (size_t i = 0; i < capacity; i++)
+            if (entries[i].last_use != 0) entries[i].last_use = 1;
+        tick = 2;
+    }
+    return tick;
+}
+
+cache_entry* command_cache::find(string_view line, uint32_t hash, uint32_t generation) {
+    for (size_t i = 0; i < capacity; i++) {
+        cache_entry& entry = entries[i];
+        if (entry.last_use != 0 && entry.hash == hash && entry.line == line) {
+            // the table changed since the line was resolved, it is resolved again
+            if (entry.generation != generation) {
+                remove(&entry);
+                break;
+            }
+            entry.last_use = next_tick();
+            hits++;
+            return &entry;
+        }
+    }
+    misses++;
+    return nullptr;
+}
+
+cache_entry* command_cache::insert(string_view line, uint32_t hash, uint32_t generation, const command_handle& handle) {
+    if (capacity == 0) return nullptr;
+
+    // a free entry has the oldest tick of all
+    cache_entry* victim = &entries[0];
+    for (size_t i = 1; i < capacity; i++)
+        if (entries[i].last_use < victim->last_use) victim = &entries[i];
+
+    victim->hash = hash;
+    victim->last_use = next_tick();
+    victim->generation = generation;
+    victim->line.assign(line.data(), line.size());
+    victim->handle = handle;
+    victim->arena.reserve(handle.get_args_size(), handle.get_size());
+    return victim;
+}
+
+void command_cache::remove(cache_entry* entry) {
+    entry->arena.reset();
+    entry->handle = command_handle();
+    entry->last_use = 0;
+}
+
+void command_cache::clear() {
+    for (size_t i = 0; i < capacity; i++) remove(&entries[i]);
+    tick = 0;
+}
@@ -0,0 +1,67 @@
+#ifndef COMMAND_CACHE_H
+#define COMMAND_CACHE_H
+
+#include <TableLinker/TableLinker.h>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// ****************************************
+// *   Cache of compiled command lines    *
+// ****************************************
+
+// a command line that already ran: the function resolved and the arguments converted
+// a repeated line goes straight to the function, without parsing, lookup or conversion
+struct cache_entry {
+    uint32_t hash = 0;
+    uint32_t last_use = 0;  // tick of the cache when it was last found, 0 when the entry is free
+    uint32_t generation = 0;// of the table when the line was resolved
+    string line;
+    command_handle handle;
+    arg_arena arena;        // the arguments stay converted between the calls
+};
+
+// few entries searched linearly, the least recently used one is replaced
+class command_cache {
+    public:
+        command_cache() : entries(nullptr), capacity(0), tick(0), hits(0), misses(0) {}
+        ~command_cache();
+
+        command_cache(const command_cache&) = delete;
+        command_cache& operator=(const command_cache&) = delete;
+
+        // number of lines kept, 0 turns the cache off
+        void resize(size_t entries);
+        bool enabled() const { return capacity > 0; }
+
+        // the entry of the line, nullptr on a miss
+        // an entry resolved in an older generation of the table is dropped and counts as a miss
+        cache_entry* find(string_view line, uint32_t hash, uint32_t generation);
+
+        // take the least recently used entry for the line, its arena empty and reserved for 'handle'
+        // 'generation' is the one of the table read before 'handle' was resolved
+        cache_entry* insert(string_view line, uint32_t hash, uint32_t generation, const command_handle& handle);
+
+        // give back an entry whose arguments did not convert
+        void remove(cache_entry* entry);
+
+        // forget every line, the counters are kept
+        void clear();
+
+        size_t get_capacity() const { return capacity; }
+        uint32_t get_hits() const { return hits; }
+        uint32_t get_misses() const { return misses; }
+
+    private:
+        cache_entry* entries;
+        size_t capacity;
+        uint32_t tick;
+        uint32_t hits;
+        uint32_t misses;
+
+        // next tick, the order of the entries is restarted if it wraps
+        uint32_t next_tick();
+};
+
+#endif
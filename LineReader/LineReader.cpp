@@ -0,0 +1,43 @@
+#include "LineReader.h"
+
+bool line_reader::feed(char c) {
+    // the line handed out by the last feed is discarded now
+    if (done) {
+        length = 0;
+        overflow = false;
+        done = false;
+    }
+
+    if (c == '\n' && last_cr) {
+        last_cr = false;
+        return false;
+    }
+    last_cr = c == '\r';
+
+    if (c == '\r' || c == '\n') {
+        if (echo) echo("\r\n");
+        done = true;
+        return true;
+    }
+
+    // backspace or delete, only inside the line
+    if (c == 8 || c == 127) {
+        if (length > 0 && !overflow) {
+            length--;
+            if (echo) echo("\b \b");
+        }
+        return false;
+    }
+
+    if (length == LINE_READER_SIZE) {
+        overflow = true;
+        return false;
+    }
+
+    buffer[length++] = c;
+    if (echo) {
+        char text[2] = {c, '\0'};
+        echo(text);
+    }
+    return false;
+}
@@ -0,0 +1,46 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// ****************************************
+// *   Incremental reader of lines        *
+// ****************************************
+
+// characters kept for one line, longer lines are dropped whole
+#ifndef LINE_READER_SIZE
+#define LINE_READER_SIZE 128
+#endif
+
+// builds command lines from bytes received one at a time, from any source, never blocking
+// handles backspace/delete, CR, LF and CRLF, and echoes what is typed if asked to
+class line_reader {
+    public:
+        line_reader() : length(0), overflow(false), last_cr(false), done(false), echo(nullptr) {}
+
+        // one byte received, true when it completes a line
+        bool feed(char c);
+
+        // the completed line, valid until the next feed
+        string_view get_line() const { return string_view(buffer, length); }
+
+        // true if the completed line did not fit and was dropped
+        bool overflowed() const { return overflow; }
+
+        // where the typed characters are echoed, nullptr turns the echo off
+        void set_echo(void (*echo)(const char* text)) { this->echo = echo; }
+
+    private:
+        char buffer[LINE_READER_SIZE];
+        size_t length;
+        bool overflow;
+        bool last_cr;   // a LF right after a CR ends nothing
+        bool done;      // the last feed completed a line, the next one starts another
+        void (*echo)(const char* text);
+};
+
+#endif
@@ -0,0 +1,489 @@
+#include "ShellServer.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+shell_server::shell_server(TinyShell& shell, server_mode mode) : shell(shell), mode(mode) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd;
+    if (epoll_fd >= 0 && wake_fd >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+}
+
+shell_server::~shell_server() {
+    stop_workers();
+
+    for (connection* conn : connections)
+        if (conn) close_connection(conn);
+    for (connection* conn : free_connections) delete conn;
+
+    for (int fd : listeners) close(fd);
+    if (!unix_path.empty()) unlink(unix_path.c_str());
+
+    for (job* item : pending) delete item;
+    for (job* item : finished) delete item;
+    for (job* item : free_jobs) delete item;
+
+    if (spare_fd >= 0) close(spare_fd);
+    if (wake_fd >= 0) close(wake_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+}
+
+bool shell_server::listen_unix(const char* path) {
+    sockaddr_un address = {};
+    if (strlen(path) >= sizeof(address.sun_path)) return false;
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+
+    // a socket file left by an old run would fail the bind, any other file at the path is kept and fails it
+    struct stat status;
+    if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode)) unlink(path);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || !add_listener(fd)) {
+        close(fd);
+        return false;
+    }
+    unix_path = path;
+    return true;
+}
+
+bool shell_server::listen_tcp(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || !add_listener(fd)) {
+        close(fd);
+        return false;
+    }
+    return true;
+}
+
+bool shell_server::add_listener(int fd) {
+    if (listen(fd, SOMAXCONN) < 0) return false;
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) return false;
+    listeners.push_back(fd);
+    return true;
+}
+
+bool shell_server::start_workers(size_t count) {
+    if (!workers.empty() || count == 0) return workers.size() == count;
+    workers_stop = false;
+    for (size_t i = 0; i < count; i++) workers.emplace_back(&shell_server::worker_loop, this);
+    return true;
+}
+
+void shell_server::stop_workers() {
+    if (workers.empty()) return;
+    {
+        lock_guard<mutex> guard(jobs_lock);
+        workers_stop = true;
+    }
+    jobs_ready.notify_all();
+    for (thread& worker : workers) worker.join();
+    workers.clear();
+
+    // the jobs that ran are delivered, the ones never taken run in the loop from now on
+    collect_jobs();
+    for (size_t i = pending_pos; i < pending.size(); i++) {
+        job* item = pending[i];
+        execute_all(item);
+        finished.push_back(item);
+    }
+    pending.clear();
+    pending_pos = 0;
+    collect_jobs();
+}
+
+void shell_server::run() {
+    while (!stopped.load()) poll(-1);
+    stopped.store(false);
+}
+
+void shell_server::stop() {
+    stopped.store(true);
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {} // already signaled when the counter is full
+}
+
+size_t shell_server::poll(int timeout_ms) {
+    epoll_event events[SERVER_MAX_EVENTS];
+    int count = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, timeout_ms);
+    if (count <= 0) return 0;
+
+    for (int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+        uint32_t ready = events[i].events;
+
+        if (fd == wake_fd) {
+            uint64_t value;
+            if (read(wake_fd, &value, sizeof(value)) < 0) {}
+            collect_jobs();
+            continue;
+        }
+
+        bool listener = false;
+        for (int listen_fd : listeners) {
+            if (fd == listen_fd) {
+                accept_all(fd);
+                listener = true;
+                break;
+            }
+        }
+        if (listener) continue;
+
+        // a connection closed earlier in this same batch is gone
+        connection* conn = static_cast<size_t>(fd) < connections.size() ? connections[fd] : nullptr;
+        if (conn == nullptr) continue;
+
+        // a hang up still leaves the last bytes to read, unless they were already read
+        if ((ready & EPOLLERR) || ((ready & EPOLLHUP) && conn->closing)) {
+            close_connection(conn);
+            continue;
+        }
+        if (ready & EPOLLOUT) flush(conn);
+        if (connections[fd] == conn && (ready & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) read_input(conn);
+    }
+    return static_cast<size_t>(count);
+}
+
+void shell_server::accept_all(int listener) {
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // out of descriptors the connection stays queued and the listener ready, the loop would spin on it
+            if ((errno == EMFILE || errno == ENFILE) && reject_pending(listener)) continue;
+            return;
+        }
+
+        // replies are small and should leave at once
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        connection* conn;
+        if (free_connections.empty()) {
+            conn = new connection();
+        } else {
+            conn = free_connections.back();
+            free_connections.pop_back();
+        }
+        conn->fd = fd;
+        conn->serial = next_serial++;
+        conn->events = EPOLLIN | EPOLLRDHUP;
+
+        epoll_event event = {};
+        event.events = conn->events;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            conn->fd = -1;
+            free_connections.push_back(conn);
+            continue;
+        }
+
+        if (static_cast<size_t>(fd) >= connections.size()) connections.resize(fd + 1, nullptr);
+        connections[fd] = conn;
+        connections_count++;
+    }
+}
+
+bool shell_server::reject_pending(int listener) {
+    // the spare descriptor makes room to accept the connection and close it at once
+    if (spare_fd >= 0) {
+        close(spare_fd);
+        int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        int error = errno;
+        if (fd >= 0) close(fd);
+        spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) return true;
+
+        // accept4 runs out of descriptors before it looks at the queue, it may have been empty
+        if (error == EAGAIN || error == EWOULDBLOCK) return false;
+    }
+
+    // without it the listeners wait until a connection closes
+    pause_accept(true);
+    return false;
+}
+
+void shell_server::pause_accept(bool paused) {
+    for (int fd : listeners) {
+        epoll_event event = {};
+        event.events = paused ? 0u : static_cast<uint32_t>(EPOLLIN);
+        event.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    }
+    accept_paused = paused;
+}
+
+void shell_server::read_input(connection* conn) {
+    char buffer[SERVER_READ_SIZE];
+
+    // level triggered, what is left in the socket comes back in the next poll
+    ssize_t received = recv(conn->fd, buffer, sizeof(buffer), 0);
+    if (received > 0) {
+        conn->input.append(buffer, static_cast<size_t>(received));
+    } else if (received == 0) {
+        conn->closing = true;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        close_connection(conn);
+        return;
+    }
+    process(conn);
+}
+
+// end of the first line, at its CR or LF, nullptr while it has not arrived
+static const char* find_line_end(const char* data, size_t size) {
+    const char* lf = static_cast<const char*>(memchr(data, '\n', size));
+    const char* cr = static_cast<const char*>(memchr(data, '\r', lf ? static_cast<size_t>(lf - data) : size));
+    return cr ? cr : lf;
+}
+
+void shell_server::process(connection* conn) {
+    // a connection has one job at a time, with every line it had buffered, so its replies keep their order
+    job* item = nullptr;
+    while (!conn->busy && conn->input_pos < conn->input.size()) {
+        const char* begin = conn->input.data() + conn->input_pos;
+        size_t available = conn->input.size() - conn->input_pos;
+        const char* end = find_line_end(begin, available);
+        if (end == nullptr) {
+            // the input holds one line shorter than SERVER_BACKLOG_LIMIT, the rest of a longer one is skipped
+            if (available >= SERVER_BACKLOG_LIMIT) {
+                conn->dropping = true;
+                conn->input_pos = conn->input.size();
+            }
+            break;
+        }
+        conn->input_pos += static_cast<size_t>(end - begin) + 1;
+
+        // in a job an empty line stands for the one dropped, real empty lines (and the one of a CRLF) run nothing
+        if (conn->dropping || static_cast<size_t>(end - begin) >= SERVER_BACKLOG_LIMIT) {
+            conn->dropping = false;
+            if (item) item->line += '\n';
+            else write_dropped(conn->output);
+            continue;
+        }
+
+        string_view line = trim_blank(string_view(begin, static_cast<size_t>(end - begin)));
+        if (line.empty()) continue;
+
+        if (workers.empty()) {
+            execute(line, conn->output);
+            continue;
+        }
+
+        if (item == nullptr) {
+            lock_guard<mutex> guard(jobs_lock);
+            if (free_jobs.empty()) {
+                item = new job();
+            } else {
+                item = free_jobs.back();
+                free_jobs.pop_back();
+            }
+            item->fd = conn->fd;
+            item->serial = conn->serial;
+            item->line.clear();
+            item->reply.clear();
+        }
+        item->line.append(line.data(), line.size());
+        item->line += '\n';
+        if (item->line.size() >= SERVER_READ_SIZE) break;
+    }
+
+    if (item) {
+        {
+            lock_guard<mutex> guard(jobs_lock);
+            pending.push_back(item);
+        }
+        jobs_ready.notify_one();
+        conn->busy = true;
+    }
+
+    // the buffer keeps its capacity for the next reads, only the start of a line stays in it
+    if (conn->input_pos == conn->input.size()) {
+        conn->input.clear();
+        conn->input_pos = 0;
+    } else if (conn->input_pos > 0) {
+        conn->input.erase(0, conn->input_pos);
+        conn->input_pos = 0;
+    }
+
+    flush(conn);
+}
+
+void shell_server::execute(string_view line, string& reply) {
+    if (mode == SERVER_MACHINE) {
+        TinyShell::CommandResult result = shell.run_command(line.data(), line.size());
+        char text[16];
+        int length = snprintf(text, sizeof(text), "%u %u %u\n", result.status, result.code, result.failed_arg);
+        reply.append(text, static_cast<size_t>(length));
+        return;
+    }
+
+    // the result is streamed into the reply, no string is built for it
+    size_t start = reply.size();
+    {
+        text_sink sink(sink_to_string, &reply);
+        shell.run_line_command(line.data(), line.size(), sink);
+    }
+    if (reply.size() == start || reply.back() != '\n') reply += '\n';
+}
+
+void shell_server::execute_all(job* item) {
+    string_view lines = item->line;
+    while (!lines.empty()) {
+        size_t end = lines.find('\n');
+        string_view line = lines.substr(0, end);
+        lines.remove_prefix(end + 1);
+
+        if (line.empty()) write_dropped(item->reply);
+        else execute(line, item->reply);
+    }
+}
+
+void shell_server::write_dropped(string& reply) {
+    // machine clients parse every reply as numbers
+    if (mode == SERVER_MACHINE) {
+        char text[16];
+        int length = snprintf(text, sizeof(text), "%u %u 0\n", SERVER_LINE_TOO_LONG, RESULT_ERROR);
+        reply.append(text, static_cast<size_t>(length));
+        return;
+    }
+    reply += "Line too long, dropped.\n";
+}
+
+void shell_server::flush(connection* conn) {
+    while (conn->output_pos < conn->output.size()) {
+        ssize_t sent = send(conn->fd, conn->output.data() + conn->output_pos, conn->output.size() - conn->output_pos, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close_connection(conn);
+            return;
+        }
+        conn->output_pos += static_cast<size_t>(sent);
+    }
+
+    if (conn->output_pos == conn->output.size()) {
+        conn->output.clear();
+        conn->output_pos = 0;
+
+        // the peer is done sending and has every reply
+        if (conn->closing && !conn->busy && conn->input.empty()) {
+            close_connection(conn);
+            return;
+        }
+    }
+    update_events(conn);
+}
+
+void shell_server::update_events(connection* conn) {
+    // stop reading a client that is waiting for a worker or not taking its replies
+    size_t backlog = (conn->input.size() - conn->input_pos) + (conn->output.size() - conn->output_pos);
+    uint32_t wanted = 0;
+    if (!conn->closing && backlog < SERVER_BACKLOG_LIMIT && (!conn->busy || conn->input.size() < SERVER_BACKLOG_LIMIT))
+        wanted |= EPOLLIN | EPOLLRDHUP;
+    if (conn->output_pos < conn->output.size()) wanted |= EPOLLOUT;
+    if (wanted == conn->events) return;
+
+    epoll_event event = {};
+    event.events = wanted;
+    event.data.fd = conn->fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->events = wanted;
+}
+
+void shell_server::close_connection(connection* conn) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    connections[conn->fd] = nullptr;
+    connections_count--;
+
+    // a job still running for it is dropped by its serial when it ends
+    conn->fd = -1;
+    conn->busy = false;
+    conn->closing = false;
+    conn->dropping = false;
+    conn->input.clear();
+    conn->input_pos = 0;
+    conn->output.clear();
+    conn->output_pos = 0;
+
+    // buffers grown by a flood are not kept
+    if (conn->input.capacity() > SERVER_READ_SIZE) string().swap(conn->input);
+    if (conn->output.capacity() > SERVER_READ_SIZE) string().swap(conn->output);
+    free_connections.push_back(conn);
+
+    // a descriptor is free again for the spare or the next connection
+    if (spare_fd < 0) spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (accept_paused) pause_accept(false);
+}
+
+void shell_server::collect_jobs() {
+    {
+        lock_guard<mutex> guard(jobs_lock);
+        finished_local.swap(finished);
+    }
+
+    for (job* item : finished_local) {
+        connection* conn = static_cast<size_t>(item->fd) < connections.size() ? connections[item->fd] : nullptr;
+        if (conn && conn->serial == item->serial) {
+            conn->output += item->reply;
+            conn->busy = false;
+            process(conn);
+        }
+    }
+
+    lock_guard<mutex> guard(jobs_lock);
+    for (job* item : finished_local) free_jobs.push_back(item);
+    finished_local.clear();
+}
+
+void shell_server::worker_loop() {
+    unique_lock<mutex> guard(jobs_lock);
+    while (true) {
+        jobs_ready.wait(guard, [this] { return workers_stop || pending_pos < pending.size(); });
+        if (workers_stop) return;
+
+        job* item = pending[pending_pos++];
+        if (pending_pos == pending.size()) {
+            pending.clear();
+            pending_pos = 0;
+        }
+
+        // the dispatch of the shell is safe from many threads, the lock is only for the queues
+        guard.unlock();
+        execute_all(item);
+        guard.lock();
+
+        finished.push_back(item);
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0) {}
+    }
+}
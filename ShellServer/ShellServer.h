@@ -0,0 +1,135 @@
+#ifndef SHELL_SERVER_H
+#define SHELL_SERVER_H
+
+#include <TinyShell.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// ****************************************
+// *   Socket server of the shell (Linux) *
+// ****************************************
+
+// events handled by one wait of the loop
+#ifndef SERVER_MAX_EVENTS
+#define SERVER_MAX_EVENTS 64
+#endif
+
+// bytes read from a socket at once
+#ifndef SERVER_READ_SIZE
+#define SERVER_READ_SIZE 4096
+#endif
+
+// bytes of input or output held for a connection before it stops being read, longer lines are dropped
+#ifndef SERVER_BACKLOG_LIMIT
+#define SERVER_BACKLOG_LIMIT 65536
+#endif
+
+// what a connection gets back for each line
+enum server_mode : uint8_t {
+    SERVER_TEXT,        // the text of run_line_command
+    SERVER_MACHINE      // "status code failed_arg\n" of run_command
+};
+
+// status of a line of SERVER_BACKLOG_LIMIT bytes or more in SERVER_MACHINE mode, after the ones of TinyShell
+#define SERVER_LINE_TOO_LONG 255
+
+// serves the commands of a shell to many local clients, one line per command,
+// on a single thread with epoll and non-blocking sockets; the commands may run in a pool of workers
+class shell_server {
+    public:
+        explicit shell_server(TinyShell& shell, server_mode mode = SERVER_TEXT);
+        ~shell_server();
+
+        shell_server(const shell_server&) = delete;
+        shell_server& operator=(const shell_server&) = delete;
+
+        // listen on a unix domain socket, an old socket at the path is replaced, false if another file is there
+        bool listen_unix(const char* path);
+
+        // listen on 127.0.0.1, never on other interfaces
+        bool listen_tcp(uint16_t port);
+
+        // run the commands in 'count' threads instead of the loop, the replies keep the order of each connection
+        // in SERVER_MACHINE mode the cache of the shell must stay disabled, it is not shared between threads
+        bool start_workers(size_t count);
+        void stop_workers();
+
+        // wait up to timeout_ms (-1 forever) and handle what is ready, returns the events handled
+        size_t poll(int timeout_ms);
+
+        // poll until stop is called, from any thread
+        void run();
+        void stop();
+
+        // the epoll descriptor, to wait on it from another loop
+        int get_fd() const { return epoll_fd; }
+        size_t get_connections() const { return connections_count; }
+
+    private:
+        struct connection {
+            int fd = -1;
+            uint32_t serial = 0;        // tells a reused descriptor from the one a job was for
+            uint32_t events = 0;        // registered in epoll
+            bool busy = false;          // its lines are running in a worker
+            bool closing = false;       // the peer stopped sending
+            bool dropping = false;      // the current line went past SERVER_BACKLOG_LIMIT, skipped up to its end
+            string input;               // received and not yet run, lines end with CR, LF or CRLF
+            size_t input_pos = 0;
+            string output;              // replies not yet sent
+            size_t output_pos = 0;
+        };
+
+        struct job {
+            int fd;
+            uint32_t serial;
+            string line;                // the lines of the connection, each ended by '\n'
+            string reply;
+        };
+
+        TinyShell& shell;
+        server_mode mode;
+        int epoll_fd;
+        int wake_fd;                    // eventfd, wakes the loop for stop and finished jobs
+        int spare_fd;                   // kept open to make room for a connection when out of descriptors
+        bool accept_paused = false;     // listeners taken out of epoll until a connection closes
+        vector<int> listeners;
+        string unix_path;
+        vector<connection*> connections;        // indexed by the descriptor
+        vector<connection*> free_connections;   // closed ones, their buffers are reused
+        size_t connections_count = 0;
+        uint32_t next_serial = 0;
+        atomic<bool> stopped{false};
+
+        vector<thread> workers;
+        mutex jobs_lock;
+        condition_variable jobs_ready;
+        vector<job*> pending;           // waiting for a worker
+        size_t pending_pos = 0;
+        vector<job*> finished;          // waiting for the loop
+        vector<job*> free_jobs;
+        vector<job*> finished_local;    // swapped with finished by the loop
+        bool workers_stop = false;
+
+        bool add_listener(int fd);
+        void accept_all(int listener);
+        bool reject_pending(int listener);
+        void pause_accept(bool paused);
+        void read_input(connection* conn);
+        void process(connection* conn);
+        void execute(string_view line, string& reply);
+        void execute_all(job* item);
+        void write_dropped(string& reply);
+        void flush(connection* conn);
+        void update_events(connection* conn);
+        void close_connection(connection* conn);
+        void collect_jobs();
+        void worker_loop();
+};
+
+#endif
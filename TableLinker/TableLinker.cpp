@@ -1,5 +1,274 @@
 #include "TableLinker.h"
+
+#ifdef ARDUINO
 #include <Arduino.h>
+#elif defined(TINY_SHELL_STATS)
+#include <chrono>
+#endif
+
+// floating point from_chars is only in recent standard libraries, the others use parse_decimal
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef TINY_SHELL_STATS
+stats_time stats_now() {
+#ifdef ARDUINO
+    return micros();
+#else
+    return static_cast<stats_time>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+static stats_alloc_counter alloc_counter = nullptr;
+
+void set_stats_alloc_counter(stats_alloc_counter counter) {
+    alloc_counter = counter;
+}
+
+size_t stats_allocations() {
+    return alloc_counter ? alloc_counter() : 0;
+}
+
+// "avg/min/max" of a phase, or "-" if it never ran
+static void write_phase(text_sink& sink, const phase_stats& phase) {
+    uint32_t count = phase.count.load(memory_order_relaxed);
+    if (count == 0) {
+        sink.write('-');
+        return;
+    }
+    sink.write_number(phase.total.load(memory_order_relaxed) / count).write('/');
+    sink.write_number(phase.min.load(memory_order_relaxed)).write('/').write_number(phase.max.load(memory_order_relaxed));
+}
+
+static void write_command_stats(text_sink& sink, string_view module, string_view func, const command_stats& stats) {
+    sink.write(module).write(" -").write(func).write(": calls=").write_number(stats.calls.load(memory_order_relaxed));
+    sink.write(" parse=");
+    write_phase(sink, stats.parse);
+    sink.write(" convert=");
+    write_phase(sink, stats.convert);
+    sink.write(" execute=");
+    write_phase(sink, stats.execute);
+    sink.write(" allocs=").write_number(stats.allocations.load(memory_order_relaxed)).write('\n');
+}
+#endif
+
+#if defined(__cpp_lib_to_chars)
+// from_chars does not take the '+' sign, and must see the whole token
+// it reads "inf" and "nan" too, which are not numbers to a command, as for parse_decimal
+template<typename T>
+static bool parse_floating(string_view data, T& out) {
+    if (!data.empty() && data[0] == '+') {
+        data.remove_prefix(1);
+        if (!data.empty() && data[0] == '-') return false;
+    }
+    const char* end = data.data() + data.size();
+    T value;
+    from_chars_result result = from_chars(data.data(), end, value);
+    if (result.ec != errc() || result.ptr != end || !isfinite(value)) return false;
+    out = value;
+    return true;
+}
+
+bool parse_arg(string_view data, float& out)  { return parse_floating(data, out); }
+bool parse_arg(string_view data, double& out) { return parse_floating(data, out); }
+#else
+static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// locale free decimal number with optional fraction and exponent, false on junk or overflow
+static bool parse_decimal(string_view data, double& out) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < data.size() && (data[i] == '-' || data[i] == '+')) negative = data[i++] == '-';
+
+    // up to 19 significant digits fit in the mantissa, the others only move the exponent
+    uint64_t mantissa = 0;
+    int32_t exponent = 0;
+    size_t digits = 0;
+    for (; i < data.size() && is_digit(data[i]); i++, digits++) {
+        if (mantissa < 1000000000000000000ull) mantissa = mantissa * 10 + (data[i] - '0');
+        else exponent++;
+    }
+    if (i < data.size() && data[i] == '.') {
+        for (i++; i < data.size() && is_digit(data[i]); i++, digits++) {
+            if (mantissa < 1000000000000000000ull) {
+                mantissa = mantissa * 10 + (data[i] - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits == 0) return false;
+
+    if (i < data.size() && (data[i] == 'e' || data[i] == 'E')) {
+        i++;
+        bool exponent_negative = false;
+        if (i < data.size() && (data[i] == '-' || data[i] == '+')) exponent_negative = data[i++] == '-';
+
+        int32_t value = 0;
+        size_t exponent_digits = 0;
+        for (; i < data.size() && is_digit(data[i]); i++, exponent_digits++)
+            if (value < 100000) value = value * 10 + (data[i] - '0');
+        if (exponent_digits == 0) return false;
+        exponent += exponent_negative ? -value : value;
+    }
+    if (i != data.size()) return false;
+
+    // scale by the powers of ten that are exact in a double
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    double value = static_cast<double>(mantissa);
+    int32_t scale = exponent < 0 ? -exponent : exponent;
+    while (scale > 0 && value != 0.0 && !isinf(value)) {
+        int32_t step = scale > 22 ? 22 : scale;
+        value = exponent < 0 ? value / powers[step] : value * powers[step];
+        scale -= step;
+    }
+    // out of the range of a double, too large or too small
+    if (isinf(value) || (value == 0.0 && mantissa != 0)) return false;
+
+    out = negative ? -value : value;
+    return true;
+}
+
+bool parse_arg(string_view data, double& out) { return parse_decimal(data, out); }
+
+bool parse_arg(string_view data, float& out) {
+    double value;
+    if (!parse_decimal(data, value) || value > FLT_MAX || value < -FLT_MAX) return false;
+    out = static_cast<float>(value);
+    if (out == 0.0f && value != 0.0) return false;
+    return true;
+}
+#endif
+
+static inline size_t count_bits(uint32_t bits) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_popcount(bits));
+#else
+    size_t count = 0;
+    for (; bits; bits &= bits - 1) count++;
+    return count;
+#endif
+}
+
+#if !defined(__SSE2__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// 0x80 in each byte of 'word' equal to 'c', exact so no byte is reported by the carry of another
+static inline uint64_t bytes_equal(uint64_t word, char c) {
+    const uint64_t low = 0x7F7F7F7F7F7F7F7Full;
+    uint64_t x = word ^ (0x0101010101010101ull * static_cast<uint8_t>(c));
+    return ~(((x & low) + low) | x | low);
+}
+#define TINY_SHELL_SWAR_ITEMS
+#endif
+
+size_t count_array_items(string_view items) {
+    // a value starts on a byte that is not a separator and follows one, the start of the text counts as one
+    const char* data = items.data();
+    size_t size = items.size();
+    size_t count = 0;
+    size_t i = 0;
+    uint32_t previous = 1;
+
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i comma = _mm_set1_epi8(',');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                                     _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf)),
+                                                  _mm_cmpeq_epi8(chunk, comma)));
+        uint32_t separators = static_cast<uint32_t>(_mm_movemask_epi8(found));
+        count += count_bits(~separators & ((separators << 1) | previous) & 0xFFFF);
+        previous = (separators >> 15) & 1;
+    }
+#elif defined(TINY_SHELL_SWAR_ITEMS)
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        uint64_t found = bytes_equal(word, ' ') | bytes_equal(word, '\t') | bytes_equal(word, '\r')
+                       | bytes_equal(word, '\n') | bytes_equal(word, ',');
+        // gather the high bit of each byte into the low byte, one bit per byte
+        uint32_t separators = static_cast<uint32_t>(((found >> 7) * 0x0102040810204080ull) >> 56);
+        count += count_bits(~separators & ((separators << 1) | previous) & 0xFF);
+        previous = (separators >> 7) & 1;
+    }
+#endif
+
+    for (; i < size; i++) {
+        uint32_t separator = is_item_separator(data[i]);
+        count += (separator ^ 1) & previous;
+        previous = separator;
+    }
+    return count;
+}
+
+string expected_types_str(const type_tag* types, size_t size) {
+    string expected_types;
+    {
+        text_sink sink(sink_to_string, &expected_types);
+        write_expected_types(sink, types, size);
+    }
+    return expected_types;
+}
+
+void write_expected_types(text_sink& sink, const type_tag* types, size_t size) {
+    sink.write('(');
+    for (size_t i = 0; i < size; i++) {
+        sink.write(type_code_str[types[i]]);
+        if (i < (size - 1))
+            sink.write(", ");
+    }
+    sink.write(')');
+}
+
+string base_function::get_expected_types_str() const {
+    return expected_types_str(param_types, size);
+}
+
+arg_arena::~arg_arena() {
+    reset();
+    delete[] buffer;
+    delete[] args;
+    delete[] destructors;
+}
+
+void arg_arena::reserve(size_t bytes, size_t arg_count) {
+    // the arena only grows, and only while it is empty
+    reset();
+
+    if (bytes > capacity) {
+        delete[] buffer;
+        size_t blocks = (bytes + sizeof(max_align_t) - 1) / sizeof(max_align_t);
+        buffer = new max_align_t[blocks];
+        capacity = blocks * sizeof(max_align_t);
+    }
+
+    if (arg_count > max_args) {
+        delete[] args;
+        delete[] destructors;
+        args = new void*[arg_count];
+        destructors = new destructor[arg_count];
+        max_args = arg_count;
+    }
+}
+
+void arg_arena::reset() {
+    // destroy in the reverse order of construction
+    while (count > 0) {
+        count--;
+        if (destructors[count]) destructors[count](args[count]);
+    }
+    used = 0;
+}
 
 function_manager::~function_manager() {
     // unique_ptr destroys pointees automatically; we just delete the array
@@ -10,7 +279,7 @@ function_manager::~function_manager() {
 
 // copy constructor (deep copy)
 function_manager::function_manager(const function_manager& other)
-    : func_array(nullptr), size(other.size) {
+    : func_array(nullptr), size(other.size), capacity(other.size) {
     if (size == 0) return;
 
     // allocate the new array
@@ -32,61 +301,78 @@ function_manager& function_manager::operator=(const function_manager& other) {
 
     // make a deep-copied temp using the copy ctor
     function_manager tmp(other);
+    return *this = move(tmp);
+}
 
-    // swap members (noexcept)
-    swap(func_array, tmp.func_array);
-    swap(size, tmp.size);
+// move constructor, takes the array without touching the functions
+function_manager::function_manager(function_manager&& other) noexcept
+    : func_array(other.func_array), size(other.size), capacity(other.capacity) {
+    other.func_array = nullptr;
+    other.size = 0;
+    other.capacity = 0;
+}
+
+// move assignment (swap, the old array is released by 'other')
+function_manager& function_manager::operator=(function_manager&& other) noexcept {
+    swap(func_array, other.func_array);
+    swap(size, other.size);
+    swap(capacity, other.capacity);
     return *this;
 }
 
-function_manager::function_manager(size_t size) : size(size) {
+function_manager::function_manager(size_t size) : size(size), capacity(size) {
     func_array = (size > 0) ? new unique_ptr<base_function>[size] : nullptr;
 }
 
-void function_manager::resize(size_t new_size) {
+void function_manager::reserve(size_t new_capacity) {
+    if (new_capacity <= capacity) return;
+
     // allocate new array
-    unique_ptr<base_function>* new_func_array = new unique_ptr<base_function>[new_size];
+    unique_ptr<base_function>* new_func_array = new unique_ptr<base_function>[new_capacity];
 
-    // copy the old data
-    size_t copy_size = (new_size < size) ? new_size : size;
-    for (size_t i = 0; i < copy_size; ++i) {
-        new_func_array[i] = func_array[i]->clone(); // deep copy of the pointee
-    }
+    // move the old pointers, the functions stay where they are
+    for (size_t i = 0; i < size; ++i)
+        new_func_array[i] = move(func_array[i]);
 
     // delete the old array
     delete[] func_array;
 
-    // update the pointer and size
+    // update the pointer and capacity
     func_array = new_func_array;
-    size = new_size;
+    capacity = new_capacity;
 }
 
-const char** function_manager::get_param_types(string name) {
+const type_tag* function_manager::get_param_types(const string& name) {
     size_t idx = select(name);
     return get_param_types(idx);
 }
 
-const char** function_manager::get_param_types(size_t idx) {
+const type_tag* function_manager::get_param_types(size_t idx) {
     if (check_index(idx)) return nullptr;
     return func_array[idx]->get_param_types();
 }
 
+base_function* function_manager::get(size_t idx) {
+    if (check_index(idx)) return nullptr;
+    return func_array[idx].get();
+}
+
 size_t function_manager::get_param_size(size_t idx) {
     if (check_index(idx)) return FUNCTION_NOT_FOUND;
     return func_array[idx]->get_size();
 }
 
-string function_manager::get_name(size_t idx) {
+const char* function_manager::get_name(size_t idx) {
     if (check_index(idx)) return "";
     return func_array[idx]->get_name();
 }
 
-string function_manager::get_description(size_t idx) {
+const char* function_manager::get_description(size_t idx) {
     if (check_index(idx)) return "";
     return func_array[idx]->get_description();
 }
 
-string function_manager::get_expected_types_str(string name) {
+string function_manager::get_expected_types_str(const string& name) {
     size_t idx = select(name);
     if (check_index(idx)) return "";
     return get_expected_types_str(idx);
@@ -94,35 +380,41 @@ string function_manager::get_expected_types_str(string name) {
 
 string function_manager::get_expected_types_str(size_t idx) {
     if (check_index(idx)) return "";
-    
-    // get the expected types from the function
-    const char** types = func_array[idx]->get_param_types();
-    size_t size_param = func_array[idx]->get_size();
+    return func_array[idx]->get_expected_types_str();
+}
 
-    // concatenate the types into a string
-    string expected_types = "(";
-    for (size_t i = 0; i < size_param; i++) {
-        expected_types += types[i];
-        if (i < (size_param - 1))
-            expected_types += ", ";
+string function_manager::get_all() {
+    string text;
+    {
+        text_sink sink(sink_to_string, &text);
+        write_all(sink);
     }
-    expected_types += ")";
+    return text;
+}
 
-    return expected_types;
+void function_manager::write_all(text_sink& sink) {
+    for (size_t i = 0; i < size; i++) {
+        sink.write('-').write(func_array[i]->get_name()).write(' ');
+        write_expected_types(sink, func_array[i]->get_param_types(), func_array[i]->get_size());
+        sink.write(" => ").write(func_array[i]->get_description()).write('\n');
+    }
+    if (size == 0) sink.write("no functions available.\n");
 }
 
-string function_manager::get_all() {
-    string text = "";
-    for (size_t i = 0; i < size; i++)
-        text += "-" + func_array[i]->get_name() + " " + get_expected_types_str(i) + " => " + func_array[i]->get_description() + "\n";
-    return text.empty() ? "no functions available.\n" : text;
+uint8_t function_manager::add(unique_ptr<base_function> func) {
+    // double the capacity when full, registering N functions is amortized O(N)
+    if (size == capacity) reserve(capacity ? capacity * 2 : 4);
+
+    // add the function at the end
+    func_array[size++] = move(func);
+    return RESULT_OK;
 }
 
 bool function_manager::check_index(size_t idx) {
     return (idx >= size);
 }
 
-bool function_manager::check_name(string name) {
+bool function_manager::check_name(const string& name) {
     size_t idx = select(name);
     return !check_index(idx);
 }
@@ -139,26 +431,217 @@ uint8_t function_manager::call(size_t idx) {
     return call(idx, nullptr);
 }
 
-uint8_t function_manager::call(string name, void** args) {
+uint8_t function_manager::call(const string& name, void** args) {
     size_t idx = select(name);
     if (check_index(idx)) return MODULE_NOT_FOUND;
     return call(idx, args);
 }
 
-size_t function_manager::select(string name) {
+size_t function_manager::select(const string& name) {
     for (size_t i = 0; i < size; i++)
         if (func_array[i]->get_name() == name)
             return i;
     return -1;
 }
 
-bool function_manager::check_expected_types(string name, size_t receive) {
+bool function_manager::check_expected_types(const string& name, size_t receive) {
     size_t idx = select(name);
     if (check_index(idx)) return false; // Function not found
     return (receive == func_array[idx]->get_size());
 }
 
-TableLinker::TableLinker(size_t table_size) : size(table_size) {
+// 0 marks an empty slot, so a hash of 0 is stored as 1
+static uint32_t slot_hash(uint32_t hash) {
+    return hash ? hash : 1;
+}
+
+static index_table* new_index_table(size_t capacity) {
+    // the slots start empty, with a zero hash
+    index_table* table = new index_table{capacity, new atomic<uint32_t>[capacity], new index_entry[capacity](), nullptr};
+    for (size_t i = 0; i < capacity; i++) table->hashes[i].store(0, memory_order_relaxed);
+    return table;
+}
+
+static void delete_index_table(index_table* table) {
+    delete[] table->hashes;
+    delete[] table->entries;
+    delete table;
+}
+
+command_index::~command_index() {
+    index_table* current = table.load();
+    if (current) delete_index_table(current);
+    while (retired) {
+        index_table* next = retired->retired;
+        delete_index_table(retired);
+        retired = next;
+    }
+}
+
+command_index::reader::reader(const command_index& index) : index(index) {
+    // counted before the table is loaded, so a writer that sees no reader also sees no old table in use
+    index.readers.fetch_add(1);
+    table = index.table.load();
+}
+
+command_index::reader::~reader() {
+    index.readers.fetch_sub(1);
+}
+
+void command_index::place(index_table* target, uint32_t hash, const index_entry& entry) {
+    size_t mask = target->capacity - 1;
+    size_t slot = hash & mask;
+    while (target->hashes[slot].load(memory_order_relaxed) != 0)
+        slot = (slot + 1) & mask;
+
+    // the hash is stored last, a reader that sees it sees the whole entry
+    target->entries[slot] = entry;
+    target->hashes[slot].store(slot_hash(hash), memory_order_release);
+}
+
+void command_index::rehash(size_t new_capacity) {
+    index_table* old_table = table.load(memory_order_relaxed);
+    index_table* new_table = new_index_table(new_capacity);
+
+    // copy the entries, the hash is stored so the names are not needed
+    if (old_table) {
+        for (size_t i = 0; i < old_table->capacity; i++) {
+            uint32_t hash = old_table->hashes[i].load(memory_order_relaxed);
+            if (hash) place(new_table, hash, old_table->entries[i]);
+        }
+    }
+
+    // publish the new table, the old one waits for the readers that may still see it
+    table.store(new_table);
+    if (old_table) {
+        old_table->retired = retired;
+        retired = old_table;
+    }
+    reclaim();
+}
+
+void command_index::reclaim() {
+    if (retired == nullptr || readers.load() != 0) return;
+    while (retired) {
+        index_table* next = retired->retired;
+        delete_index_table(retired);
+        retired = next;
+    }
+}
+
+void command_index::reserve(size_t entries) {
+    // smallest power of two that keeps the load factor below 1/2
+    index_table* current = table.load(memory_order_relaxed);
+    size_t capacity = current ? current->capacity : 0;
+    size_t new_capacity = capacity ? capacity : 16;
+    while (entries * 2 > new_capacity) new_capacity *= 2;
+    if (new_capacity > capacity) rehash(new_capacity);
+}
+
+void command_index::insert(uint32_t hash, uint16_t module, uint16_t function, const char* key, const char* name, base_function* func) {
+    // keep the load factor below 1/2 so the probes stay short
+    index_table* current = table.load(memory_order_relaxed);
+    size_t capacity = current ? current->capacity : 0;
+    if ((count + 1) * 2 > capacity) rehash(capacity ? capacity * 2 : 16);
+
+    // an empty slot of the published table is filled in place
+    place(table.load(memory_order_relaxed), hash, index_entry{module, function, key, name, func});
+    count++;
+    reclaim();
+}
+
+const index_entry* command_index::reader::find(uint32_t hash, const index_entry* from) const {
+    if (table == nullptr) return nullptr;
+
+    hash = slot_hash(hash);
+    size_t mask = table->capacity - 1;
+    size_t slot = from ? ((from - table->entries + 1) & mask) : (hash & mask);
+
+    // walk the packed hashes until an empty slot, the entries are only read on a match
+    for (uint32_t stored; (stored = table->hashes[slot].load(memory_order_acquire)) != 0; slot = (slot + 1) & mask)
+        if (stored == hash) return &table->entries[slot];
+    return nullptr;
+}
+
+name_pool::~name_pool() {
+    for (size_t i = 0; i < blocks_count; i++) delete[] blocks[i];
+    delete[] blocks;
+    delete[] slots;
+    delete[] hashes;
+}
+
+void name_pool::add_block(char* block) {
+    if (blocks_count == blocks_capacity) {
+        size_t new_capacity = blocks_capacity ? blocks_capacity * 2 : 4;
+        char** new_blocks = new char*[new_capacity];
+        if (blocks_count) memcpy(new_blocks, blocks, blocks_count * sizeof(char*));
+        delete[] blocks;
+        blocks = new_blocks;
+        blocks_capacity = new_capacity;
+    }
+    blocks[blocks_count++] = block;
+}
+
+char* name_pool::allocate(size_t bytes) {
+    used += bytes;
+
+    // a long name gets a block of its own, kept before the last one so its free space is not lost
+    if (bytes > NAME_POOL_BLOCK) {
+        char* block = new char[bytes];
+        add_block(block);
+        if (blocks_count > 1) swap(blocks[blocks_count - 1], blocks[blocks_count - 2]);
+        return block;
+    }
+
+    if (bytes > block_free) {
+        add_block(new char[NAME_POOL_BLOCK]);
+        block_free = NAME_POOL_BLOCK;
+    }
+    char* data = blocks[blocks_count - 1] + (NAME_POOL_BLOCK - block_free);
+    block_free -= bytes;
+    return data;
+}
+
+void name_pool::grow() {
+    size_t new_capacity = capacity ? capacity * 2 : 32;
+    const char** new_slots = new const char*[new_capacity]();
+    uint32_t* new_hashes = new uint32_t[new_capacity];
+
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] == nullptr) continue;
+        size_t slot = hashes[i] & (new_capacity - 1);
+        while (new_slots[slot]) slot = (slot + 1) & (new_capacity - 1);
+        new_slots[slot] = slots[i];
+        new_hashes[slot] = hashes[i];
+    }
+
+    delete[] slots;
+    delete[] hashes;
+    slots = new_slots;
+    hashes = new_hashes;
+    capacity = new_capacity;
+}
+
+const char* name_pool::intern(string_view name) {
+    if ((count + 1) * 2 > capacity) grow();
+
+    uint32_t hash = hash_name(name);
+    size_t slot = hash & (capacity - 1);
+    for (; slots[slot]; slot = (slot + 1) & (capacity - 1))
+        if (hashes[slot] == hash && name == slots[slot]) return slots[slot];
+
+    // first time the name is seen, it is copied once with its terminator
+    char* data = allocate(name.size() + 1);
+    if (!name.empty()) memcpy(data, name.data(), name.size());
+    data[name.size()] = '\0';
+
+    slots[slot] = data;
+    hashes[slot] = hash;
+    count++;
+    return data;
+}
+
+TableLinker::TableLinker(size_t table_size) : size(table_size), capacity(table_size) {
     if (size == 0) {
         commands_array = nullptr;
         module_name = nullptr;
@@ -166,26 +649,30 @@ TableLinker::TableLinker(size_t table_size) : size(table_size) {
         return;
     }
     commands_array = new function_manager[size];
-    module_name = new string[size];
-    module_description = new string[size];
+    module_name = new const char*[size];
+    module_description = new const char*[size];
+    for (size_t i = 0; i < size; i++) module_name[i] = module_description[i] = "";
 }
 
 TableLinker::~TableLinker() {
     delete[] commands_array;
     delete[] module_name;
     delete[] module_description;
+    for (size_t i = 0; i < ID_CHUNKS; i++) delete[] id_chunks[i].load();
+    STATS_ONLY(delete[] static_stats;)
 }
 
-void TableLinker::resize(size_t new_size) {
+void TableLinker::reserve(size_t new_capacity) {
+    if (new_capacity <= capacity) return;
+
     // alocate new arrays
-    function_manager* new_commands = new function_manager[new_size];
-    string* new_names = new string[new_size];
-    string* new_descriptions = new string[new_size];
-
-    // copy the old data
-    size_t copy_size = (new_size < size) ? new_size : size;
-    for (size_t i = 0; i < copy_size; ++i) {
-        new_commands[i] = commands_array[i];
+    function_manager* new_commands = new function_manager[new_capacity];
+    const char** new_names = new const char*[new_capacity];
+    const char** new_descriptions = new const char*[new_capacity];
+
+    // move the old data, no function or name is copied
+    for (size_t i = 0; i < size; ++i) {
+        new_commands[i] = move(commands_array[i]);
         new_names[i] = module_name[i];
         new_descriptions[i] = module_description[i];
     }
@@ -195,59 +682,346 @@ void TableLinker::resize(size_t new_size) {
     delete[] module_name;
     delete[] module_description;
 
-    // update the pointers and the new size
+    // update the pointers and the new capacity
     commands_array = new_commands;
     module_name = new_names;
     module_description = new_descriptions;
-    size = new_size;
+    capacity = new_capacity;
 }
 
-uint8_t TableLinker::create_module(string mod_name, string mod_description) {
+void TableLinker::reserve(size_t modules, size_t functions) {
+    table_guard guard(lock);
+    reserve(modules);
+    index.reserve(modules + functions);
+}
+
+uint8_t TableLinker::create_module(string_view mod_name, const char* mod_description) {
+    table_guard guard(lock);
     // check if the module already exists
     if (check_module_name(mod_name)) return MODULE_NOT_FOUND; // Module already exists
     // find the next available index
     return create_module(size, mod_name, mod_description);
 }
 
-string TableLinker::get_all_module(string name) {
+string TableLinker::get_all_module(const string& name) {
+    string text;
+    {
+        text_sink sink(sink_to_string, &text);
+        write_all_module(sink, name);
+    }
+    return text;
+}
+
+void TableLinker::write_all_module(text_sink& sink, string_view name) {
+    table_guard guard(lock);
     size_t idx = select_module(name);
-    return get_all_module(idx);
+    if (check_index(idx)) {
+        // list a module of the static table
+        const static_module* module = select_static_module(name);
+        if (module == nullptr) return write_all_module(sink, idx);
+
+        sink.write(module->name).write(": ").write(module->description).write('\n');
+        for (size_t i = 0; i < module->size; i++) {
+            const static_command& command = module->commands[i];
+            sink.write('-').write(command.name).write(' ');
+            write_expected_types(sink, command.param_types, command.size);
+            sink.write(" => ").write(command.description).write('\n');
+        }
+        if (module->size == 0) sink.write("no functions available.\n");
+        return;
+    }
+    write_all_module(sink, idx);
 }
 
 string TableLinker::get_all() {
-    string text = "";
+    string text;
+    {
+        text_sink sink(sink_to_string, &text);
+        write_all(sink);
+    }
+    return text;
+}
+
+void TableLinker::write_all(text_sink& sink) {
+    table_guard guard(lock);
     for (size_t i = 0; i < size; i++)
-        text += module_name[i] + " => " + module_description[i] + "\n";
-    return text.empty() ? "no modules available.\n" : text;
+        sink.write(module_name[i]).write(" => ").write(module_description[i]).write('\n');
+    const static_module* modules;
+    size_t count = get_static(modules);
+    for (size_t i = 0; i < count; i++)
+        sink.write(modules[i].name).write(" => ").write(modules[i].description).write('\n');
+    if (size == 0 && count == 0) sink.write("no modules available.\n");
 }
 
-uint8_t TableLinker::call(string module_name, string func_name) {
-    size_t mod_idx = select_module(module_name);
-    if (check_index(mod_idx)) return MODULE_NOT_FOUND; // Module not found
-    return commands_array[mod_idx].call(func_name);
+uint8_t TableLinker::attach_static(const static_module* modules, size_t count) {
+    table_guard guard(lock);
+    // a table being read is never replaced
+    if (modules == nullptr || static_modules.load(memory_order_relaxed) != nullptr) return RESULT_ERROR;
+
+    // the static commands are also built in the arenas
+    [[maybe_unused]] size_t commands = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < modules[i].size; j++) {
+            const static_command& command = modules[i].commands[j];
+            if (command.size > max_arity) max_arity = command.size;
+            if (command.args_size > max_args_size) max_args_size = command.args_size;
+        }
+        commands += modules[i].size;
+    }
+    STATS_ONLY(static_stats = new command_stats[commands];)
+
+    static_modules.store(modules, memory_order_relaxed);
+    static_size.store(count, memory_order_release);
+    generation.fetch_add(1, memory_order_release);
+    return RESULT_OK;
+}
+
+size_t TableLinker::get_static(const static_module*& modules) const {
+    // a size seen makes the pointer stored before it visible
+    size_t count = static_size.load(memory_order_acquire);
+    modules = static_modules.load(memory_order_relaxed);
+    return count;
+}
+
+command_handle TableLinker::static_handle(const static_command* command, [[maybe_unused]] size_t position) const {
+#ifdef TINY_SHELL_STATS
+    return command_handle(command, &static_stats[position]);
+#else
+    return command_handle(command);
+#endif
+}
+
+const static_module* TableLinker::select_static_module(string_view name) {
+    const static_module* modules;
+    size_t count = get_static(modules);
+    for (size_t i = 0; i < count; i++)
+        if (name == modules[i].name)
+            return &modules[i];
+    return nullptr;
 }
 
-uint8_t TableLinker::create_module(size_t idx, string mod_name, string mod_description) {
-    // resize the array if necessary
-    if (idx == size) resize(size + 1);
+uint8_t TableLinker::call(const string& module_name, const string& func_name) {
+    return call(module_name, func_name, nullptr);
+}
+
+uint8_t TableLinker::create_module(size_t idx, string_view mod_name, const char* mod_description) {
+    table_guard guard(lock);
+
+    // the index stores positions in 16 bits
+    if (idx >= INDEX_EMPTY) return RESULT_ERROR;
+
+    // double the capacity when full, registering N modules is amortized O(N)
+    if (idx == size) {
+        if (size == capacity) reserve(capacity ? capacity * 2 : 4);
+        size++;
+    }
 
     if (check_index(idx)) return MODULE_NOT_FOUND; // index out of bounds
 
     // set the module name and description
-    module_name[idx] = mod_name;
-    module_description[idx] = mod_description;
+    // the name is interned, so it stays put when the arrays grow and the readers compare against it
+    module_name[idx] = names.intern(mod_name);
+    module_description[idx] = mod_description ? mod_description : "";
+    index.insert(hash_name(mod_name), idx, INDEX_MODULE, module_name[idx], nullptr, nullptr);
+    generation.fetch_add(1, memory_order_release);
     return RESULT_OK;
 }
 
-uint8_t TableLinker::call(string module_name, string func_name, void** args) {
-    size_t mod_idx = select_module(module_name);
+uint8_t TableLinker::add_func_to_module(string_view name, unique_ptr<base_function> func, bool numbered) {
+    table_guard guard(lock);
+
+    // a function built by the caller may hold a name that does not last
+    func->name = names.intern(func->name);
+    size_t mod_idx = select_module(name);
     if (check_index(mod_idx)) return MODULE_NOT_FOUND; // Module not found
-    return commands_array[mod_idx].call(func_name, args);
+    uint8_t result = commands_array[mod_idx].add(move(func));
+    if (result != RESULT_OK) return result;
+    result = index_function(mod_idx, numbered);
+    generation.fetch_add(1, memory_order_release);
+    return result;
 }
 
-bool TableLinker::check_module_name(string name) {
-    size_t idx = select_module(name);
-    return !check_index(idx);
+uint8_t TableLinker::index_function(size_t mod_idx, bool numbered) {
+    // the function just added is the last one of the module
+    size_t func_idx = commands_array[mod_idx].get_size() - 1;
+    if (func_idx >= INDEX_MODULE) return RESULT_ERROR;
+
+    // keep track of the largest arguments to size the arenas
+    base_function* func = commands_array[mod_idx].get(func_idx);
+    if (func->get_size() > max_arity) max_arity = func->get_size();
+    if (func->get_args_size() > max_args_size) max_args_size = func->get_args_size();
+
+    // duplicated names keep resolving to the first registered function
+    const char* func_name = func->get_name();
+    if (find(module_name[mod_idx], func_name)) return RESULT_OK;
+
+    index.insert(hash_command(module_name[mod_idx], func_name), mod_idx, func_idx, module_name[mod_idx], func_name, func);
+    if (!numbered) return RESULT_OK;
+
+    // the next id, the ids of the static table are never reached
+    size_t id = ids_size.load(memory_order_relaxed);
+    size_t chunk, offset;
+    if (id < STATIC_COMMAND_ID && id_position(id, chunk, offset)) {
+        base_function** ids = id_chunks[chunk].load(memory_order_relaxed);
+        if (ids == nullptr) {
+            ids = new base_function*[ID_CHUNK_FIRST << chunk]();
+            id_chunks[chunk].store(ids, memory_order_release);
+        }
+        // the id is written before the size that makes it visible
+        ids[offset] = func;
+        ids_size.store(id + 1, memory_order_release);
+    }
+    return RESULT_OK;
+}
+
+bool TableLinker::id_position(size_t id, size_t& chunk, size_t& offset) {
+    // chunk k starts at ID_CHUNK_FIRST * (2^k - 1)
+    size_t first = 0;
+    for (chunk = 0; chunk < ID_CHUNKS; chunk++) {
+        size_t chunk_size = static_cast<size_t>(ID_CHUNK_FIRST) << chunk;
+        if (id < first + chunk_size) {
+            offset = id - first;
+            return true;
+        }
+        first += chunk_size;
+    }
+    return false;
+}
+
+base_function* TableLinker::find(string_view mod_name, string_view func_name) {
+    uint32_t hash = hash_command(mod_name, func_name);
+
+    // the hash is 32 bits, so the names are checked to discard collisions
+    command_index::reader reader(index);
+    for (const index_entry* entry = reader.find(hash); entry; entry = reader.find(hash, entry)) {
+        if (entry->func && func_name == entry->name && mod_name == entry->key) return entry->func;
+    }
+    return nullptr;
+}
+
+command_handle TableLinker::resolve(string_view mod_name, string_view func_name) {
+    base_function* func = find(mod_name, func_name);
+    if (func || static_size.load(memory_order_acquire) == 0) return command_handle(func);
+
+    // the static table is not indexed, so it costs nothing at boot and is scanned instead
+    const static_module* modules;
+    size_t count = get_static(modules);
+    size_t position = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (mod_name == modules[i].name) {
+            for (size_t j = 0; j < modules[i].size; j++)
+                if (func_name == modules[i].commands[j].name) return static_handle(&modules[i].commands[j], position + j);
+            return command_handle();
+        }
+        position += modules[i].size;
+    }
+    return command_handle();
+}
+
+command_handle TableLinker::resolve(uint16_t id) {
+    if (id < STATIC_COMMAND_ID) {
+        size_t chunk, offset;
+        if (id >= ids_size.load(memory_order_acquire) || !id_position(id, chunk, offset)) return command_handle();
+        return command_handle(id_chunks[chunk].load(memory_order_acquire)[offset]);
+    }
+
+    // the static commands are numbered across the modules, in the order of the table
+    const static_module* modules;
+    size_t count = get_static(modules);
+    size_t position = id - STATIC_COMMAND_ID;
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (position < offset + modules[i].size) return static_handle(&modules[i].commands[position - offset], position);
+        offset += modules[i].size;
+    }
+    return command_handle();
+}
+
+uint16_t TableLinker::get_command_id(string_view mod_name, string_view func_name) {
+    // only used to discover the ids, so the positions are scanned
+    base_function* func = find(mod_name, func_name);
+    if (func) {
+        size_t count = ids_size.load(memory_order_acquire);
+        size_t chunk, offset;
+        for (size_t i = 0; i < count && id_position(i, chunk, offset); i++)
+            if (id_chunks[chunk].load(memory_order_acquire)[offset] == func) return static_cast<uint16_t>(i);
+        return COMMAND_ID_NONE;
+    }
+
+    const static_module* modules;
+    size_t count = get_static(modules);
+    size_t id = STATIC_COMMAND_ID;
+    for (size_t i = 0; i < count; i++) {
+        if (mod_name == modules[i].name) {
+            for (size_t j = 0; j < modules[i].size; j++)
+                if (func_name == modules[i].commands[j].name && id + j < COMMAND_ID_NONE) return static_cast<uint16_t>(id + j);
+            return COMMAND_ID_NONE;
+        }
+        id += modules[i].size;
+    }
+    return COMMAND_ID_NONE;
+}
+
+uint8_t TableLinker::call(const string& module_name, const string& func_name, void** args) {
+    command_handle handle = resolve(module_name, func_name);
+    if (!handle.valid())
+        return check_module_name(module_name) ? FUNCTION_NOT_FOUND : MODULE_NOT_FOUND;
+
+#ifdef TINY_SHELL_STATS
+    size_t allocs = stats_allocations();
+    uint8_t result = handle.call(args);
+    handle.get_stats().add_allocations(stats_allocations() - allocs);
+    return result;
+#else
+    return handle.call(args);
+#endif
+}
+
+#ifdef TINY_SHELL_STATS
+string TableLinker::get_stats() {
+    string text;
+    {
+        text_sink sink(sink_to_string, &text);
+        write_stats(sink);
+    }
+    return text;
+}
+
+void TableLinker::write_stats(text_sink& sink) {
+    table_guard guard(lock);
+    sink.write("times in " STATS_TIME_UNIT " as avg/min/max\n");
+    for (size_t i = 0; i < size; i++) {
+        for (size_t j = 0; j < commands_array[i].get_size(); j++) {
+            base_function* func = commands_array[i].get(j);
+            if (func->get_stats().calls) write_command_stats(sink, module_name[i], func->get_name(), func->get_stats());
+        }
+    }
+    const static_module* modules;
+    size_t count = get_static(modules);
+    for (size_t i = 0, position = 0; i < count; position += modules[i].size, i++) {
+        for (size_t j = 0; j < modules[i].size; j++) {
+            const command_stats& stats = static_stats[position + j];
+            if (stats.calls) write_command_stats(sink, modules[i].name, modules[i].commands[j].name, stats);
+        }
+    }
+}
+
+void TableLinker::reset_stats() {
+    table_guard guard(lock);
+    for (size_t i = 0; i < size; i++)
+        for (size_t j = 0; j < commands_array[i].get_size(); j++)
+            commands_array[i].get(j)->get_stats().reset();
+    const static_module* modules;
+    size_t count = get_static(modules);
+    size_t commands = 0;
+    for (size_t i = 0; i < count; i++) commands += modules[i].size;
+    for (size_t i = 0; i < commands; i++) static_stats[i].reset();
+}
+#endif
+
+bool TableLinker::check_module_name(string_view name) {
+    // a module is in the index only once it is complete, so the size is not read
+    return select_module(name) != static_cast<size_t>(-1) || select_static_module(name) != nullptr;
 }
 
 bool TableLinker::check_index(size_t idx) {
@@ -261,41 +1035,42 @@ size_t TableLinker::select(string name) {
     return RESULT_ERROR;
 }
 
-size_t TableLinker::select_module(string name) {
-    for (size_t i = 0; i < size; i++)
-        if (module_name[i] == name)
-            return i;
-    return RESULT_ERROR;
+size_t TableLinker::select_module(string_view name) {
+    uint32_t hash = hash_name(name);
+    command_index::reader reader(index);
+    for (const index_entry* entry = reader.find(hash); entry; entry = reader.find(hash, entry))
+        if (entry->function == INDEX_MODULE && name == entry->key)
+            return entry->module;
+    return -1;
 }
 
-string TableLinker::get_all_module(size_t idx) {
-    if (check_index(idx)) return "module not found.\n";
-    string text =   module_name[idx] + ": " +
-                    module_description[idx] + "\n" + 
-                    commands_array[idx].get_all();
-    return text;
+void TableLinker::write_all_module(text_sink& sink, size_t idx) {
+    if (check_index(idx)) {
+        sink.write("module not found.\n");
+        return;
+    }
+    sink.write(module_name[idx]).write(": ").write(module_description[idx]).write('\n');
+    commands_array[idx].write_all(sink);
 }
 
-bool TableLinker::check_function_name(string module_name, string func_name) {
-    size_t mod_idx = select_module(module_name);
-    if (check_index(mod_idx)) return false; // Module not found
-    return commands_array[mod_idx].check_name(func_name);
+bool TableLinker::check_function_name(const string& module_name, const string& func_name) {
+    return resolve(module_name, func_name).valid();
 }
 
-string TableLinker::get_expected_types_str(string module_name, string func_name) {
-    size_t mod_idx = select_module(module_name);
-    if (check_index(mod_idx)) return ""; // Module not found
-    return commands_array[mod_idx].get_expected_types_str(func_name);
+string TableLinker::get_expected_types_str(const string& module_name, const string& func_name) {
+    command_handle handle = resolve(module_name, func_name);
+    if (!handle.valid()) return ""; // Function not found
+    return handle.get_expected_types_str();
 }
 
-const char** TableLinker::get_param_types(string module_name, string func_name) {
-    size_t mod_idx = select_module(module_name);
-    if (check_index(mod_idx)) return nullptr; // Module not found
-    return commands_array[mod_idx].get_param_types(func_name);
+const type_tag* TableLinker::get_param_types(const string& module_name, const string& func_name) {
+    command_handle handle = resolve(module_name, func_name);
+    if (!handle.valid()) return nullptr; // Function not found
+    return handle.get_param_types();
 }
 
-bool TableLinker::check_expected_types(string module_name, string func_name, size_t receive) {
-    size_t mod_idx = select_module(module_name);
-    if (check_index(mod_idx)) return false; // Module not found
-    return commands_array[mod_idx].check_expected_types(func_name, receive);
-}
\ No newline at end of file
+bool TableLinker::check_expected_types(const string& module_name, const string& func_name, size_t receive) {
+    command_handle handle = resolve(module_name, func_name);
+    if (!handle.valid()) return false; // Function not found
+    return receive == handle.get_size();
+}
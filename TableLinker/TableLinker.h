@@ -8,12 +8,29 @@
 #define MODULE_NOT_FOUND 253
 
 #include <memory>
-#include <functional>
 #include <typeindex>
 #include <typeinfo>
 #include <utility>
+#include <tuple>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <atomic>
+#include <new>
+#include <TextSink/TextSink.h>
+
+#if defined(ESP_PLATFORM)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#elif !defined(ARDUINO)
+#include <mutex>
+#endif
 
 using namespace std;
 
@@ -21,29 +38,466 @@ using namespace std;
 // * Templates to converte typeid to char *
 // ****************************************
 
+// compact tag of each supported type, indexes the converters table
+enum type_tag : uint8_t {
+    TYPE_U1,
+    TYPE_I1,
+    TYPE_I4,
+    TYPE_U4,
+    TYPE_I8,
+    TYPE_U8,
+    TYPE_F4,
+    TYPE_F8,
+    TYPE_C1,
+    TYPE_B1,
+    TYPE_S0,
+    TYPE_U1_ARRAY,      // vector<T> written as "[v1 v2 ...]"
+    TYPE_I1_ARRAY,
+    TYPE_I4_ARRAY,
+    TYPE_U4_ARRAY,
+    TYPE_I8_ARRAY,
+    TYPE_U8_ARRAY,
+    TYPE_F4_ARRAY,
+    TYPE_F8_ARRAY,
+    TYPE_UNKNOWN,
+    TYPE_COUNT
+};
+
+// codes of the tags, only used by the help output
+inline constexpr const char* type_code_str[] = {
+    "u1", "i1", "i4", "u4", "i8", "u8", "f4", "f8", "c1", "b1", "s0",
+    "u1[]", "i1[]", "i4[]", "u4[]", "i8[]", "u8[]", "f4[]", "f8[]", "??"
+};
+
+// the tables indexed by tag are sized by their entries, so a missing one fails the build instead of being a null
+#define TYPE_TABLE_CHECK(table) static_assert(sizeof(table) / sizeof(table[0]) == TYPE_COUNT, #table " needs one entry per type_tag")
+TYPE_TABLE_CHECK(type_code_str);
+
+template<typename T>
+constexpr type_tag type_tag_of() {
+    if constexpr (is_same<T, uint8_t>::value)   return TYPE_U1;
+    if constexpr (is_same<T, int8_t>::value)    return TYPE_I1;
+    if constexpr (is_same<T, int32_t>::value)   return TYPE_I4;
+    if constexpr (is_same<T, uint32_t>::value)  return TYPE_U4;
+    if constexpr (is_same<T, int64_t>::value)   return TYPE_I8;
+    if constexpr (is_same<T, uint64_t>::value)  return TYPE_U8;
+    if constexpr (is_same<T, float>::value)     return TYPE_F4;
+    if constexpr (is_same<T, double>::value)    return TYPE_F8;
+    if constexpr (is_same<T, char>::value)      return TYPE_C1;
+    if constexpr (is_same<T, bool>::value)      return TYPE_B1;
+    if constexpr (is_same<T, string>::value)    return TYPE_S0;
+    if constexpr (is_same<T, vector<uint8_t>>::value)   return TYPE_U1_ARRAY;
+    if constexpr (is_same<T, vector<int8_t>>::value)    return TYPE_I1_ARRAY;
+    if constexpr (is_same<T, vector<int32_t>>::value)   return TYPE_I4_ARRAY;
+    if constexpr (is_same<T, vector<uint32_t>>::value)  return TYPE_U4_ARRAY;
+    if constexpr (is_same<T, vector<int64_t>>::value)   return TYPE_I8_ARRAY;
+    if constexpr (is_same<T, vector<uint64_t>>::value)  return TYPE_U8_ARRAY;
+    if constexpr (is_same<T, vector<float>>::value)     return TYPE_F4_ARRAY;
+    if constexpr (is_same<T, vector<double>>::value)    return TYPE_F8_ARRAY;
+    return TYPE_UNKNOWN;  // Unknown type
+}
+
 template<typename T>
 constexpr const char* type_code() {
-    if constexpr (is_same<T, uint8_t>::value)   return "u1";
-    if constexpr (is_same<T, int8_t>::value)    return "i1";
-    if constexpr (is_same<T, int32_t>::value)   return "i4";
-    if constexpr (is_same<T, uint32_t>::value)  return "u4";
-    if constexpr (is_same<T, float>::value)     return "f4";
-    if constexpr (is_same<T, double>::value)    return "f8";
-    if constexpr (is_same<T, char>::value)      return "c1";
-    if constexpr (is_same<T, string>::value)    return "s0";
-    return "??";  // Unknown type
-}
-
-inline void* convert_type_char(const char* data, const char* type_code) {
-    if (strcmp(type_code, "u1") == 0) return new uint8_t(static_cast<uint8_t>(atoi(data)));
-    if (strcmp(type_code, "i4") == 0) return new int32_t(atoi(data));
-    if (strcmp(type_code, "f4") == 0) return new float(atof(data));
-    if (strcmp(type_code, "f8") == 0) return new double(atof(data));
-    if (strcmp(type_code, "c1") == 0) return new char(data[0]);
-    if (strcmp(type_code, "s0") == 0) return new string(data);
-    throw invalid_argument("Unknown type code");
+    return type_code_str[type_tag_of<T>()];
+}
+
+// ****************************************
+// *     Storage of the arguments         *
+// ****************************************
+
+// bytes taken by one argument of type T inside the arena
+template<typename T>
+constexpr size_t arg_size() {
+    return (sizeof(T) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+}
+
+// fixed capacity buffer where the arguments of one command are constructed
+// the capacity is reserved on registration and the arena is reset after each command
+class arg_arena {
+    public:
+        arg_arena() : buffer(nullptr), capacity(0), used(0), args(nullptr), destructors(nullptr), max_args(0), count(0) {}
+        ~arg_arena();
+
+        arg_arena(const arg_arena&) = delete;
+        arg_arena& operator=(const arg_arena&) = delete;
+
+        // grow the storage to hold 'bytes' of arguments in 'arg_count' slots
+        void reserve(size_t bytes, size_t arg_count);
+
+        // construct a T in the buffer, nullptr if it does not fit
+        template<typename T, typename... A>
+        T* emplace(A&&... values) {
+            size_t offset = (used + alignof(T) - 1) / alignof(T) * alignof(T);
+            if (count >= max_args || offset + sizeof(T) > capacity) return nullptr;
+
+            T* ptr = new (reinterpret_cast<unsigned char*>(buffer) + offset) T(forward<A>(values)...);
+            args[count] = ptr;
+            destructors[count] = is_trivially_destructible<T>::value ? nullptr : &destroy<T>;
+            count++;
+            used = offset + sizeof(T);
+            return ptr;
+        }
+
+        // arguments constructed since the last reset, in order
+        void** get_args() { return args; }
+        size_t get_count() const { return count; }
+
+        // destroy the arguments, the storage is kept for the next command
+        void reset();
+
+    private:
+        typedef void (*destructor)(void*);
+
+        max_align_t* buffer;
+        size_t capacity;
+        size_t used;
+        void** args;
+        destructor* destructors;
+        size_t max_args;
+        size_t count;
+
+        template<typename T>
+        static void destroy(void* ptr) { static_cast<T*>(ptr)->~T(); }
+};
+
+// ****************************************
+// *     Conversion of the arguments      *
+// ****************************************
+
+// whitespace accepted around the module, command and arguments
+inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// trim the view in place, no copies are made
+inline string_view trim_blank(string_view text) {
+    while (!text.empty() && is_blank(text.front())) text.remove_prefix(1);
+    while (!text.empty() && is_blank(text.back())) text.remove_suffix(1);
+    return text;
+}
+
+// position of the comma that ends the first argument, npos if it is the last one
+// an argument that starts with '[' is an array and may hold commas up to its ']'
+inline size_t arg_end(string_view args) {
+    size_t start = 0;
+    while (start < args.size() && is_blank(args[start])) start++;
+    if (start < args.size() && args[start] == '[') {
+        size_t close = args.find(']', start);
+        if (close != string_view::npos) return args.find(',', close);
+    }
+    return args.find(',');
+}
+
+// take the next comma separated argument out of 'args', trimmed
+inline string_view next_arg(string_view& args) {
+    size_t comma = arg_end(args);
+    string_view arg = args.substr(0, comma);
+    args = (comma == string_view::npos) ? string_view() : args.substr(comma + 1);
+    return trim_blank(arg);
+}
+
+// decimal integer with an optional sign, false on junk or when the value does not fit in T
+// locale free and works on the view, the token does not need to be null terminated
+template<typename T>
+bool parse_integer(string_view data, T& out) {
+    bool negative = false;
+    if (!data.empty() && (data[0] == '-' || data[0] == '+')) {
+        negative = data[0] == '-';
+        data.remove_prefix(1);
+    }
+    if (data.empty() || (negative && !is_signed<T>::value)) return false;
+
+    // the negative side of a signed type goes one further
+    const uint64_t limit = static_cast<uint64_t>(numeric_limits<T>::max()) + (negative ? 1 : 0);
+    uint64_t value = 0;
+    for (char c : data) {
+        if (c < '0' || c > '9') return false;
+        uint8_t digit = c - '0';
+        if (value > (limit - digit) / 10) return false;
+        value = value * 10 + digit;
+    }
+
+    out = static_cast<T>(negative ? 0 - value : value);
+    return true;
+}
+
+// parse the text of one argument straight into its type, false on failure
+inline bool parse_arg(string_view data, uint8_t& out)  { return parse_integer(data, out); }
+inline bool parse_arg(string_view data, int8_t& out)   { return parse_integer(data, out); }
+inline bool parse_arg(string_view data, int32_t& out)  { return parse_integer(data, out); }
+inline bool parse_arg(string_view data, uint32_t& out) { return parse_integer(data, out); }
+inline bool parse_arg(string_view data, int64_t& out)  { return parse_integer(data, out); }
+inline bool parse_arg(string_view data, uint64_t& out) { return parse_integer(data, out); }
+bool parse_arg(string_view data, float& out);
+bool parse_arg(string_view data, double& out);
+inline bool parse_arg(string_view data, char& out)     { if (data.size() != 1) return false; out = data[0]; return true; }
+inline bool parse_arg(string_view data, string& out)   { out.assign(data.data(), data.size()); return true; }
+
+inline bool parse_arg(string_view data, bool& out) {
+    if (data == "1" || data == "true") out = true;
+    else if (data == "0" || data == "false") out = false;
+    else return false;
+    return true;
+}
+
+// the values of an array are separated by blanks or commas
+inline bool is_item_separator(char c) {
+    return is_blank(c) || c == ',';
+}
+
+// number of values between the brackets of an array, scanned 16 (SSE2) or 8 (SWAR) bytes at a time
+size_t count_array_items(string_view items);
+
+// "[v1 v2 ...]" parsed in one pass into a vector reserved for all of its values
+template<typename T>
+bool parse_arg(string_view data, vector<T>& out) {
+    if (data.size() < 2 || data.front() != '[' || data.back() != ']') return false;
+    data = data.substr(1, data.size() - 2);
+
+    out.clear();
+    out.reserve(count_array_items(data));
+
+    const char* it = data.data();
+    const char* end = it + data.size();
+    while (true) {
+        while (it != end && is_item_separator(*it)) it++;
+        if (it == end) return true;
+
+        const char* start = it;
+        while (it != end && !is_item_separator(*it)) it++;
+
+        T value;
+        if (!parse_arg(string_view(start, it - start), value)) return false;
+        out.push_back(value);
+    }
+}
+
+// types without a parser never convert
+template<typename T>
+bool parse_arg(string_view, T&) { return false; }
+
+// errors of a conversion are returned, never thrown, so the failure path costs like the success one
+enum convert_status : uint8_t {
+    CONVERT_OK,
+    CONVERT_INVALID,        // the text is not a value of the type
+    CONVERT_UNKNOWN_TYPE,   // the type has no converter
+    CONVERT_NO_SPACE        // the arena was not reserved for the argument
+};
+
+struct convert_result {
+    void* ptr;  // the converted value in the arena, nullptr on failure
+    convert_status status;
+};
+
+// converts the text of one argument into the arena
+typedef convert_result (*type_converter)(string_view data, arg_arena& arena);
+
+template<typename T>
+convert_result convert_arg(string_view data, arg_arena& arena) {
+    T* ptr = arena.emplace<T>();
+    if (!ptr) return {nullptr, CONVERT_NO_SPACE};
+    if (!parse_arg(data, *ptr)) return {nullptr, CONVERT_INVALID};
+    return {ptr, CONVERT_OK};
 }
 
+inline convert_result convert_unknown(string_view, arg_arena&) { return {nullptr, CONVERT_UNKNOWN_TYPE}; }
+
+// indexed by type_tag, one call per argument
+inline constexpr type_converter type_converters[] = {
+    convert_arg<uint8_t>,   // TYPE_U1
+    convert_arg<int8_t>,    // TYPE_I1
+    convert_arg<int32_t>,   // TYPE_I4
+    convert_arg<uint32_t>,  // TYPE_U4
+    convert_arg<int64_t>,   // TYPE_I8
+    convert_arg<uint64_t>,  // TYPE_U8
+    convert_arg<float>,     // TYPE_F4
+    convert_arg<double>,    // TYPE_F8
+    convert_arg<char>,      // TYPE_C1
+    convert_arg<bool>,      // TYPE_B1
+    convert_arg<string>,    // TYPE_S0
+    convert_arg<vector<uint8_t>>,   // TYPE_U1_ARRAY
+    convert_arg<vector<int8_t>>,    // TYPE_I1_ARRAY
+    convert_arg<vector<int32_t>>,   // TYPE_I4_ARRAY
+    convert_arg<vector<uint32_t>>,  // TYPE_U4_ARRAY
+    convert_arg<vector<int64_t>>,   // TYPE_I8_ARRAY
+    convert_arg<vector<uint64_t>>,  // TYPE_U8_ARRAY
+    convert_arg<vector<float>>,     // TYPE_F4_ARRAY
+    convert_arg<vector<double>>,    // TYPE_F8_ARRAY
+    convert_unknown         // TYPE_UNKNOWN
+};
+TYPE_TABLE_CHECK(type_converters);
+
+inline convert_result convert_type_char(string_view data, type_tag tag, arg_arena& arena) {
+    return type_converters[tag](data, arena);
+}
+
+// ****************************************
+// *   Instrumentation of the commands    *
+// ****************************************
+
+// define TINY_SHELL_STATS (in every unit, e.g. as a build flag) to record per command
+// call count, latency of the parse, convert and execute phases, and heap allocations
+// without it nothing below is compiled and the hot path pays nothing
+#ifdef TINY_SHELL_STATS
+
+// micros() on Arduino, nanoseconds on the host
+#ifdef ARDUINO
+#define STATS_TIME_UNIT "us"
+#else
+#define STATS_TIME_UNIT "ns"
+#endif
+
+// microseconds that wrap after 71 minutes on Arduino, 64-bit nanoseconds elsewhere so long commands never wrap
+#ifdef ARDUINO
+typedef uint32_t stats_time;
+#else
+typedef uint64_t stats_time;
+#endif
+stats_time stats_now();
+
+// counter of heap allocations, provided by the application (e.g. a counting operator new)
+typedef size_t (*stats_alloc_counter)();
+void set_stats_alloc_counter(stats_alloc_counter counter);
+size_t stats_allocations();
+
+// the counters are relaxed atomics, commands dispatched from many contexts at once are all counted
+// a reader sees each counter whole, though not always the counters of one same call together
+struct phase_stats {
+    atomic<uint32_t> count{0};
+    atomic<uint64_t> total{0};
+    atomic<stats_time> min{~stats_time(0)};
+    atomic<stats_time> max{0};
+
+    phase_stats() = default;
+    phase_stats(const phase_stats& other) { *this = other; }
+    phase_stats& operator=(const phase_stats& other) {
+        count.store(other.count.load(memory_order_relaxed), memory_order_relaxed);
+        total.store(other.total.load(memory_order_relaxed), memory_order_relaxed);
+        min.store(other.min.load(memory_order_relaxed), memory_order_relaxed);
+        max.store(other.max.load(memory_order_relaxed), memory_order_relaxed);
+        return *this;
+    }
+
+    void add(stats_time elapsed) {
+        count.fetch_add(1, memory_order_relaxed);
+        total.fetch_add(elapsed, memory_order_relaxed);
+        stats_time low = min.load(memory_order_relaxed);
+        while (elapsed < low && !min.compare_exchange_weak(low, elapsed, memory_order_relaxed)) {}
+        stats_time high = max.load(memory_order_relaxed);
+        while (elapsed > high && !max.compare_exchange_weak(high, elapsed, memory_order_relaxed)) {}
+    }
+
+    void reset() {
+        count.store(0, memory_order_relaxed);
+        total.store(0, memory_order_relaxed);
+        min.store(~stats_time(0), memory_order_relaxed);
+        max.store(0, memory_order_relaxed);
+    }
+};
+
+struct command_stats {
+    atomic<uint32_t> calls{0};
+    phase_stats parse;
+    phase_stats convert;
+    phase_stats execute;
+    atomic<uint64_t> allocations{0};
+
+    // a cloned function starts with the counters of the original
+    command_stats() = default;
+    command_stats(const command_stats& other) { *this = other; }
+    command_stats& operator=(const command_stats& other) {
+        calls.store(other.calls.load(memory_order_relaxed), memory_order_relaxed);
+        parse = other.parse;
+        convert = other.convert;
+        execute = other.execute;
+        allocations.store(other.allocations.load(memory_order_relaxed), memory_order_relaxed);
+        return *this;
+    }
+
+    void add_allocations(size_t count) { allocations.fetch_add(count, memory_order_relaxed); }
+
+    void reset() {
+        calls.store(0, memory_order_relaxed);
+        parse.reset();
+        convert.reset();
+        execute.reset();
+        allocations.store(0, memory_order_relaxed);
+    }
+};
+
+// execute time of the last function timed in this context, taken out of the conversion by its caller
+#if defined(ARDUINO) && !defined(ESP_PLATFORM)
+inline stats_time stats_last_execute = 0;
+#else
+inline thread_local stats_time stats_last_execute = 0;
+#endif
+
+// time the function itself, the caller adds it to the counters of the command
+template<typename F, typename... A>
+uint8_t timed_execute(F&& func, A&&... args) {
+    stats_time start = stats_now();
+    uint8_t result = func(forward<A>(args)...);
+    stats_last_execute = stats_now() - start;
+    return result;
+}
+
+// time the function itself and count it, whatever path called it
+template<typename F, typename... A>
+uint8_t timed_invoke(command_stats& stats, F&& func, A&&... args) {
+    uint8_t result = timed_execute(forward<F>(func), forward<A>(args)...);
+    stats.execute.add(stats_last_execute);
+    stats.calls.fetch_add(1, memory_order_relaxed);
+    return result;
+}
+
+// code that only exists with the instrumentation
+#define STATS_ONLY(...) __VA_ARGS__
+#else
+#define STATS_ONLY(...)
+#endif
+
+// ****************************************
+// *   Dispatch of the typed arguments    *
+// ****************************************
+
+// Converts void* to the expected argument type
+// Returns default value if ptr is nullptr
+template<typename T>
+T get_arg(void* ptr) {
+    if (ptr == nullptr)
+        return T{};  // Default-initialized value (e.g., 0, "", false)
+    return *reinterpret_cast<T*>(ptr);
+}
+
+// call 'func' with arguments already built as void* (e.g. in an arg_arena)
+// a null array (e.g. TableLinker::call without args) passes default values
+template<typename... param, typename F, size_t... Is>
+uint8_t call_with_args(F&& func, [[maybe_unused]] void** args, index_sequence<Is...>) {
+    return func(get_arg<typename remove_reference<param>::type>(args ? args[Is] : nullptr)...);
+}
+
+// parse each argument into a local of the parameter type and call 'func', no void** involved
+// returns false with the index of the argument that did not convert
+template<typename... param, typename F, size_t... Is>
+bool parse_and_call(F&& func, [[maybe_unused]] string_view args, uint8_t& result, [[maybe_unused]] size_t& failed_arg, index_sequence<Is...>) {
+    tuple<typename decay<param>::type...> values;
+
+    // the fold runs left to right and stops on the first argument that fails
+    bool parsed = (... && (parse_arg(next_arg(args), get<Is>(values)) || (failed_arg = Is, false)));
+    if (!parsed) return false;
+
+    result = func(move(get<Is>(values))...);
+    return true;
+}
+
+// bytes of the arguments and "(t1, t2, ...)" of a list of tags
+template<typename... param>
+constexpr size_t args_size_of() { return (0 + ... + arg_size<param>()); }
+
+string expected_types_str(const type_tag* types, size_t size);
+void write_expected_types(text_sink& sink, const type_tag* types, size_t size);
+
 // *************************************
 // * Class to create generic functions *
 // *************************************
@@ -51,98 +505,307 @@ inline void* convert_type_char(const char* data, const char* type_code) {
 // abstract class to create the generics
 class base_function {
     public:
-        base_function() : param_types(nullptr), size(0) {}   // <--- Faltava isso
-        virtual ~base_function() { delete[] param_types; }
-        
-        base_function(const base_function& other) : name(other.name), description(other.description), size(other.size) {
-            if (other.param_types && size) {
-                param_types = new const char*[size];
-                for (size_t i = 0; i < size; ++i) param_types[i] = other.param_types[i];
-            } else {
-                param_types = nullptr;
-            }
-        }
-
-        base_function& operator=(const base_function& other) {
-            if (this == &other) return *this;
-            delete[] param_types;
-            size = other.size;
-            name = other.name;
-            description = other.description;
-            if (other.param_types && size) {
-                param_types = new const char*[size];
-                for (size_t i = 0; i < size; ++i) param_types[i] = other.param_types[i];
-            } else {
-                param_types = nullptr;
-            }
-            return *this;
-        }
+        base_function() : param_types(nullptr), size(0), args_size(0) {}   // <--- Faltava isso
+        virtual ~base_function() {}
 
         virtual uint8_t call(void** args) = 0;
+
+        // parse the arguments text straight into the parameters and call the function
+        // returns false with the index of the argument that did not convert
+        virtual bool parse_call(string_view args, uint8_t& result, size_t& failed_arg) = 0;
+
         virtual unique_ptr<base_function> clone() const = 0;
-        const char** get_param_types() { return param_types; };
+        const type_tag* get_param_types() const { return param_types; };
         size_t get_size() const { return size; }
-        string get_name() { return name; }
-        string get_description() { return description; }
+        size_t get_args_size() const { return args_size; }
+        const char* get_name() const { return name; }
+        const char* get_description() const { return description; }
+        string get_expected_types_str() const;
+#ifdef TINY_SHELL_STATS
+        command_stats& get_stats() { return stats; }
+#endif
     protected:
-        const char** param_types = nullptr;
-        string name;
-        string description;
+        const type_tag* param_types = nullptr;   // static array of the class_function
+        const char* name = "";                  // interned in the name pool of the table
+        const char* description = "";           // never copied, e.g. a literal in flash/rodata
         size_t size;
+        size_t args_size;   // bytes needed to build the arguments in an arg_arena
+#ifdef TINY_SHELL_STATS
+        command_stats stats;
+#endif
+
+        // the table moves the name into its pool on registration
+        friend class TableLinker;
 };
 
-// template class to save functions with variable parameters
-template<typename... param>
-class class_function : public base_function {
+// template class with the typed part of the functions: types, conversion and dispatch
+// 'derived' provides invoke(param...), so the stored callable is reached without a second virtual call
+template<typename derived, typename... param>
+class typed_function : public base_function {
     public:
-        class_function(function<uint8_t(param...)> func_ptr, string func_name, string func_description) : func(func_ptr) {
+        // both texts must outlive the function, the table interns the name when it is registered
+        typed_function(const char* func_name, const char* func_description) {
             size = sizeof...(param);
-            param_types = new const char*[size];
-            name = func_name;
-            description = func_description;
+            args_size = args_size_of<param...>();
+            param_types = tags;
+            name = func_name ? func_name : "";
+            description = func_description ? func_description : "";
+        }
 
-            // Convert each parameter type to a single identifying character
-            size_t i = 0;
-            using expander = int[];
-            (void)expander{0, ((param_types[i++] = type_code<param>()), 0)...};
+        // This function is called to invoke the stored function
+        uint8_t call(void** args) override {
+            return call_with_args<param...>(invoker(), args, index_sequence_for<param...>{});
+        }
+
+        // Parses each argument into a local of the parameter type, no void** involved
+        bool parse_call(string_view args, uint8_t& result, size_t& failed_arg) override {
+            return parse_and_call<param...>(invoker(), args, result, failed_arg, index_sequence_for<param...>{});
+        }
+
+    private:
+        // forwards to derived::invoke without a virtual call
+        auto invoker() {
+            return [this](auto&&... args) -> uint8_t {
+#ifdef TINY_SHELL_STATS
+                return timed_invoke(stats, [this](auto&&... values) -> uint8_t {
+                    return static_cast<derived*>(this)->invoke(forward<decltype(values)>(values)...);
+                }, forward<decltype(args)>(args)...);
+#else
+                return static_cast<derived*>(this)->invoke(forward<decltype(args)>(args)...);
+#endif
+            };
         }
+
+        // tag of each parameter, built at compile time (one extra so it is never empty)
+        static constexpr type_tag tags[sizeof...(param) + 1] = {type_tag_of<param>()..., TYPE_UNKNOWN};
+};
+
+// template class to save plain functions, called straight through the raw pointer
+template<typename... param>
+class class_function : public typed_function<class_function<param...>, param...> {
+    public:
+        class_function(uint8_t(*func_ptr)(param...), const char* func_name, const char* func_description)
+            : typed_function<class_function<param...>, param...>(func_name, func_description), func(func_ptr) {}
+
         unique_ptr<base_function> clone() const override {
             return make_unique<class_function>(*this);
         }
 
-        // This function is called to invoke the stored function
-        uint8_t call(void** args) override {
-            return callDispatch(args, index_sequence_for<param...>{});
+        uint8_t invoke(param... args) { return func(forward<param>(args)...); }
+
+    private:
+        uint8_t (*func)(param...);
+};
+
+// *************************************
+// *   Callables with captured state   *
+// *************************************
+
+// bytes available to store a callable (e.g. a lambda with captures) inline
+#ifndef CALLABLE_INLINE_SIZE
+#define CALLABLE_INLINE_SIZE (4 * sizeof(void*))
+#endif
+
+// small callable stored inside the object, never on the heap
+template<typename signature>
+class inline_callable;
+
+template<typename... param>
+class inline_callable<uint8_t(param...)> {
+    public:
+        template<typename F>
+        inline_callable(F func) : invoker(&invoke_as<F>), manager(&manage_as<F>) {
+            static_assert(sizeof(F) <= CALLABLE_INLINE_SIZE, "callable too big, increase CALLABLE_INLINE_SIZE");
+            static_assert(alignof(F) <= alignof(max_align_t), "callable over aligned");
+            new (storage) F(move(func));
+        }
+
+        inline_callable(const inline_callable& other) : invoker(other.invoker), manager(other.manager) {
+            manager(storage, other.storage);
         }
 
+        inline_callable& operator=(const inline_callable&) = delete;
+
+        ~inline_callable() { manager(storage, nullptr); }
+
+        uint8_t operator()(param... args) { return invoker(storage, forward<param>(args)...); }
+
     private:
-        // Specialization for functions with NO parameters
-        uint8_t callDispatch(void**, index_sequence<>) {
-            return func();  // Safe: function expects no arguments
+        alignas(max_align_t) unsigned char storage[CALLABLE_INLINE_SIZE];
+        uint8_t (*invoker)(void*, param...);
+        void (*manager)(void* dst, const void* src);  // copies from src, or destroys dst if src is nullptr
+
+        template<typename F>
+        static uint8_t invoke_as(void* func, param... args) {
+            return (*static_cast<F*>(func))(forward<param>(args)...);
         }
 
-        // General case for functions with one or more parameters
-        template<size_t... Is>
-        uint8_t callDispatch(void** args, index_sequence<Is...>) {
-            return func(this->template getArg<typename remove_reference<param>::type>(args[Is])...);
+        template<typename F>
+        static void manage_as(void* dst, const void* src) {
+            if (src) new (dst) F(*static_cast<const F*>(src));
+            else static_cast<F*>(dst)->~F();
         }
+};
 
-        // Converts void* to the expected argument type
-        // Returns default value if ptr is nullptr
-        template<typename T>
-        T getArg(void* ptr) {
-            if (ptr == nullptr)
-                return T{};  // Default-initialized value (e.g., 0, "", false)
-            return *reinterpret_cast<T*>(ptr);
+// template class to save callables with captures (lambdas, functors)
+template<typename... param>
+class closure_function : public typed_function<closure_function<param...>, param...> {
+    public:
+        template<typename F>
+        closure_function(F func_obj, const char* func_name, const char* func_description)
+            : typed_function<closure_function<param...>, param...>(func_name, func_description), func(move(func_obj)) {}
+
+        unique_ptr<base_function> clone() const override {
+            return make_unique<closure_function>(*this);
+        }
+
+        uint8_t invoke(param... args) { return func(forward<param>(args)...); }
+
+    private:
+        inline_callable<uint8_t(param...)> func;
+};
+
+// deduce the closure_function of a callable from its operator()
+template<typename F>
+struct callable_traits : callable_traits<decltype(&F::operator())> {};
+
+template<typename C, typename... param>
+struct callable_traits<uint8_t (C::*)(param...) const> { typedef closure_function<param...> function_type; };
+
+template<typename C, typename... param>
+struct callable_traits<uint8_t (C::*)(param...)> { typedef closure_function<param...> function_type; };
+
+// only class types (lambdas, functors) take the callable path
+template<typename F>
+using enable_if_callable = typename enable_if<is_class<typename decay<F>::type>::value, uint8_t>::type;
+
+// **********************************
+// *     Static command tables      *
+// **********************************
+
+// command described at compile time, the whole table can live in flash/rodata
+struct static_command {
+    const char* name;
+    const char* description;
+    const type_tag* param_types;
+    size_t size;
+    size_t args_size;
+    uint8_t (*call)(void** args);
+    bool (*parse_call)(string_view args, uint8_t& result, size_t& failed_arg);
+};
+
+struct static_module {
+    const char* name;
+    const char* description;
+    const static_command* commands;
+    size_t size;
+};
+
+// generates the invokers of a function known at compile time
+template<auto func, typename signature = decltype(func)>
+struct static_invoker;
+
+template<auto func, typename... param>
+struct static_invoker<func, uint8_t(*)(param...)> {
+    static constexpr type_tag tags[sizeof...(param) + 1] = {type_tag_of<param>()..., TYPE_UNKNOWN};
+
+#ifdef TINY_SHELL_STATS
+    // one function may back many entries, the handle of the entry counts the call in the counters of the table
+    static uint8_t invoke(param... args) { return timed_execute(func, forward<param>(args)...); }
+#else
+    static uint8_t invoke(param... args) { return func(forward<param>(args)...); }
+#endif
+
+    static uint8_t call(void** args) {
+        return call_with_args<param...>(invoke, args, index_sequence_for<param...>{});
+    }
+
+    static bool parse_call(string_view args, uint8_t& result, size_t& failed_arg) {
+        return parse_and_call<param...>(invoke, args, result, failed_arg, index_sequence_for<param...>{});
+    }
+
+    static constexpr static_command make(const char* name, const char* description) {
+        return {name, description, tags, sizeof...(param), args_size_of<param...>(), &call, &parse_call};
+    }
+};
+
+// e.g. static constexpr static_command commands[] = { STATIC_COMMAND(teste_1, "t1", "Teste") };
+#define STATIC_COMMAND(func, name, description) static_invoker<func>::make(name, description)
+
+// e.g. static constexpr static_module modules[] = { static_module_of("teste", "Testes", commands) };
+template<size_t N>
+constexpr static_module static_module_of(const char* name, const char* description, const static_command (&commands)[N]) {
+    return {name, description, commands, N};
+}
+
+// handle to a resolved command, resolve once and reuse it to check, type and call
+// the handle stays valid while the function is registered in the table
+class command_handle {
+    public:
+        command_handle() : func(nullptr), command(nullptr) {}
+        explicit command_handle(base_function* func) : func(func), command(nullptr) {}
+#ifdef TINY_SHELL_STATS
+        // the table is constant, the counters of the entry live in RAM
+        command_handle(const static_command* command, command_stats* stats) : func(nullptr), command(command), stats(stats) {}
+#else
+        explicit command_handle(const static_command* command) : func(nullptr), command(command) {}
+#endif
+
+        bool valid() const { return func != nullptr || command != nullptr; }
+
+        // an invalid handle has no parameters and its calls fail with FUNCTION_NOT_FOUND
+        size_t get_size() const { return func ? func->get_size() : command ? command->size : 0; }
+        const type_tag* get_param_types() const { return func ? func->get_param_types() : command ? command->param_types : nullptr; }
+        size_t get_args_size() const { return func ? func->get_args_size() : command ? command->args_size : 0; }
+        string_view get_name() const { return func ? string_view(func->get_name()) : command ? string_view(command->name) : string_view(); }
+        string get_expected_types_str() const { return expected_types_str(get_param_types(), get_size()); }
+        void write_expected_types(text_sink& sink) const { ::write_expected_types(sink, get_param_types(), get_size()); }
+
+        uint8_t call(void** args = nullptr) const {
+            if (func) return func->call(args);
+            if (!command) return FUNCTION_NOT_FOUND;
+            uint8_t result = command->call(args);
+            STATS_ONLY(count_static();)
+            return result;
         }
 
-        function<uint8_t(param...)> func;
+        bool parse_call(string_view args, uint8_t& result, size_t& failed_arg) const {
+            if (func) return func->parse_call(args, result, failed_arg);
+            if (command) {
+                if (!command->parse_call(args, result, failed_arg)) return false;
+                STATS_ONLY(count_static();)
+                return true;
+            }
+            result = FUNCTION_NOT_FOUND;
+            failed_arg = 0;
+            return false;
+        }
+
+#ifdef TINY_SHELL_STATS
+        // counters of nothing for an invalid handle
+        command_stats& get_stats() const {
+            static command_stats none;
+            return func ? func->get_stats() : command ? *stats : none;
+        }
+#endif
+    private:
+        base_function* func;                // registered at runtime
+        const static_command* command;      // or declared in a static table
+#ifdef TINY_SHELL_STATS
+        command_stats* stats = nullptr;     // of the entry of the static table
+
+        // the static function timed itself, its time goes to the entry that ran
+        void count_static() const {
+            stats->execute.add(stats_last_execute);
+            stats->calls.fetch_add(1, memory_order_relaxed);
+        }
+#endif
 };
 
 // class to save the pointers
 class function_manager {
     public:
-        function_manager() : func_array(nullptr), size(0) {}
+        function_manager() : func_array(nullptr), size(0), capacity(0) {}
         function_manager(size_t size);
         ~function_manager();
 
@@ -150,103 +813,344 @@ class function_manager {
         function_manager(const function_manager& other);
         function_manager& operator=(const function_manager& other);
 
+        // move, the functions keep their addresses
+        function_manager(function_manager&& other) noexcept;
+        function_manager& operator=(function_manager&& other) noexcept;
+
+        // grow the storage ahead of the registrations
+        void reserve(size_t new_capacity);
+
         // gets
-        const char** get_param_types(string name);
+        const type_tag* get_param_types(const string& name);
+        base_function* get(size_t idx);
+        size_t get_size() const { return size; }
         size_t get_param_size(size_t idx);
-        string get_name(size_t idx);
-        string get_description(size_t idx);
+        const char* get_name(size_t idx);
+        const char* get_description(size_t idx);
         string get_all();
-        string get_expected_types_str(string name);
+        void write_all(text_sink& sink);
+        string get_expected_types_str(const string& name);
 
         // checks
-        bool check_name(string name);
-        bool check_expected_types(string name, size_t receive);
+        bool check_name(const string& name);
+        bool check_expected_types(const string& name, size_t receive);
 
         // calls
-        uint8_t call(string name, void** args = nullptr);
+        uint8_t call(const string& name, void** args = nullptr);
 
         template<typename... param>
-        uint8_t add(uint8_t(*func)(param...), string name, string description) {
-            return add(size, func, name, description);
+        uint8_t add(uint8_t(*func)(param...), const char* name, const char* description) {
+            return add(make_unique<class_function<param...>>(func, name, description));
         }
 
+        template<typename F>
+        enable_if_callable<F> add(F&& func, const char* name, const char* description) {
+            typedef typename callable_traits<typename decay<F>::type>::function_type function_type;
+            return add(make_unique<function_type>(forward<F>(func), name, description));
+        }
+
+        uint8_t add(unique_ptr<base_function> func);
+
     private:
         // function pointers
         unique_ptr<base_function>* func_array;
         size_t size;
+        size_t capacity;
 
-        size_t select(string name);
-        void resize(size_t size);
+        size_t select(const string& name);
         bool check_index(size_t idx);
         uint8_t call(size_t idx, void** args);
-        const char** get_param_types(size_t idx);
+        const type_tag* get_param_types(size_t idx);
         string get_expected_types_str(size_t idx);
         uint8_t call(size_t idx);
+};
 
-        template<typename... param>
-        uint8_t add(size_t idx, uint8_t(*func)(param...), string name, string description) {
-            // resize the array if necessary
-            if (idx == size) resize(size + 1);
+// **********************************
+// *   Hash index of the commands   *
+// **********************************
 
-            // check vector limit
-            if (check_index(idx)) return RESULT_ERROR;
+// hash used by the index, FNV-1a over the bytes of the name
+inline uint32_t hash_name(string_view name, uint32_t seed = 2166136261u) {
+    for (char c : name) {
+        seed ^= static_cast<uint8_t>(c);
+        seed *= 16777619u;
+    }
+    return seed;
+}
 
-            // add into vector
-            func_array[idx] = make_unique<class_function<param...>>(function<uint8_t(param...)>(func), name, description);
-            return RESULT_OK;
-        }
+// the key of a command is "module/function", hashed without building the string
+inline uint32_t hash_command(string_view module, string_view func) {
+    return hash_name(func, hash_name("/", hash_name(module)));
+}
+
+// open addressing table (linear probing) built on registration
+// modules are stored with function == INDEX_MODULE, functions with their position
+#define INDEX_EMPTY  0xFFFF
+#define INDEX_MODULE 0xFFFF
+
+// cold part of a slot, only read once its hash matched
+// the readers only follow stable pointers: the function and the interned names
+struct index_entry {
+    uint16_t module;
+    uint16_t function;
+    const char* key;                // name of the module
+    const char* name;               // name of the function, nullptr for a module
+    base_function* func;            // nullptr for a module
+};
+
+// the hashes are packed apart from the entries, so a probe scans 16 of them per cache line
+// a slot is empty while its hash is 0; the hash is stored last and publishes the entry
+struct index_table {
+    size_t capacity;
+    atomic<uint32_t>* hashes;
+    index_entry* entries;
+    index_table* retired;           // next table waiting for the readers to leave
+};
+
+// read-copy-update: the readers never block, a writer fills empty slots in place or publishes a new table
+// a replaced table is freed once no reader is inside the index, the writers are serialized by the TableLinker
+class command_index {
+    public:
+        command_index() : table(nullptr), count(0), retired(nullptr), readers(0) {}
+        ~command_index();
+
+        command_index(const command_index&) = delete;
+        command_index& operator=(const command_index&) = delete;
+
+        void insert(uint32_t hash, uint16_t module, uint16_t function, const char* key, const char* name, base_function* func);
+        void reserve(size_t entries);
+
+        // read-side section, the table it sees stays alive until it ends
+        class reader {
+            public:
+                explicit reader(const command_index& index);
+                ~reader();
+
+                reader(const reader&) = delete;
+                reader& operator=(const reader&) = delete;
+
+                // returns the next entry with the same hash after 'from' (nullptr starts the probe)
+                const index_entry* find(uint32_t hash, const index_entry* from = nullptr) const;
+
+            private:
+                const command_index& index;
+                const index_table* table;
+        };
+
+    private:
+        atomic<index_table*> table;
+        size_t count;
+        index_table* retired;
+        mutable atomic<uint32_t> readers;
+
+        void rehash(size_t new_capacity);
+        void place(index_table* target, uint32_t hash, const index_entry& entry);
+        void reclaim();
+};
+
+// **********************************
+// *       Pool of the names        *
+// **********************************
+
+// bytes of each block of the pool, longer names get a block of their own
+#ifndef NAME_POOL_BLOCK
+#define NAME_POOL_BLOCK 256
+#endif
+
+// every module and function name is stored once, packed with the others in blocks that never move,
+// so a name used by many modules costs one copy and its pointer stays valid for the readers
+class name_pool {
+    public:
+        name_pool() {}
+        ~name_pool();
+
+        name_pool(const name_pool&) = delete;
+        name_pool& operator=(const name_pool&) = delete;
+
+        // the stored copy of a name, the same pointer for equal names
+        const char* intern(string_view name);
+
+        // bytes taken by the names, with their terminators
+        size_t get_used() const { return used; }
+
+    private:
+        char** blocks = nullptr;
+        size_t blocks_count = 0;
+        size_t blocks_capacity = 0;
+        size_t block_free = 0;              // bytes left in the last block
+        size_t used = 0;
+
+        // open addressing set of the stored names, only touched on registration
+        const char** slots = nullptr;
+        uint32_t* hashes = nullptr;
+        size_t capacity = 0;
+        size_t count = 0;
 
+        char* allocate(size_t bytes);
+        void add_block(char* block);
+        void grow();
+};
+
+// ****************************************
+// *   Lock of the writers of the table   *
+// ****************************************
+
+// serializes the registrations and the listings, which read what the registrations change
+// the dispatch (find, resolve, call) never takes it, recursive so public calls can nest
+#if defined(ESP_PLATFORM)
+class table_lock {
+    public:
+        table_lock() : handle(xSemaphoreCreateRecursiveMutex()) {}
+        ~table_lock() { vSemaphoreDelete(handle); }
+        void lock() { xSemaphoreTakeRecursive(handle, portMAX_DELAY); }
+        void unlock() { xSemaphoreGiveRecursive(handle); }
+    private:
+        SemaphoreHandle_t handle;
 };
+#elif !defined(ARDUINO)
+typedef recursive_mutex table_lock;
+#else
+// a single core without threads has nothing to serialize
+struct table_lock {
+    void lock() {}
+    void unlock() {}
+};
+#endif
+
+struct table_guard {
+    explicit table_guard(table_lock& lock) : lock(lock) { lock.lock(); }
+    ~table_guard() { lock.unlock(); }
+    table_lock& lock;
+};
+
+// **********************************
+// *   Numeric ids of the commands  *
+// **********************************
+
+// runtime commands get ids in the order they are registered, static ones start at STATIC_COMMAND_ID
+#define COMMAND_ID_NONE   0xFFFF
+#define STATIC_COMMAND_ID 0x8000
+
+// the ids of the runtime commands live in chunks that never move, chunk k holds ID_CHUNK_FIRST << k ids
+#define ID_CHUNK_FIRST 16
+#define ID_CHUNKS      12
 
 // **********************************
 // *      Class of TableLinker      *
 // **********************************
 
+// the dispatch (find, resolve, call and the checks by name) may run from many tasks at once, and
+// concurrently with the registrations, without blocking; the registrations and the listings are serialized
 class TableLinker {
     public:
-        TableLinker() : commands_array(nullptr), module_name(nullptr), module_description(nullptr), size(0) {}
+        TableLinker() : commands_array(nullptr), module_name(nullptr), module_description(nullptr), size(0), capacity(0) {}
         TableLinker(size_t table_size);
         ~TableLinker();
 
         // gets
         string get_all();
-        uint8_t create_module(string mod_name, string mod_description);
-        string get_all_module(string name);
-        string get_expected_types_str(string module_name, string func_name);
+        // the name is interned, the description is kept by pointer and must outlive the table
+        uint8_t create_module(string_view mod_name, const char* mod_description);
+        string get_all_module(const string& name);
+
+        // the same listings, streamed to a sink without building the text
+        void write_all(text_sink& sink);
+        void write_all_module(text_sink& sink, string_view name);
+
+        // grow the storage ahead of the registrations
+        void reserve(size_t modules, size_t functions);
+        string get_expected_types_str(const string& module_name, const string& func_name);
 
         // checks
-        bool check_module_name(string name);
-        bool check_function_name(string module_name, string func_name);
-        bool check_expected_types(string module_name, string func_name, size_t receive);
-        const char** get_param_types(string module_name, string func_name);
+        bool check_module_name(string_view name);
+        bool check_function_name(const string& module_name, const string& func_name);
+        bool check_expected_types(const string& module_name, const string& func_name, size_t receive);
+        const type_tag* get_param_types(const string& module_name, const string& func_name);
 
         // calls
-        uint8_t call(string module_name, string func_name);
-        uint8_t call(string module_name, string func_name, void** args);
+        uint8_t call(const string& module_name, const string& func_name);
+        uint8_t call(const string& module_name, const string& func_name, void** args);
+
+        // resolve a command in one probe of the index, nullptr if not found
+        base_function* find(string_view module_name, string_view func_name);
+
+        // resolve a command once, the handle is used to check, type and call it
+        command_handle resolve(string_view module_name, string_view func_name);
+
+        // resolve a command by its numeric id, without any name, invalid if not found
+        command_handle resolve(uint16_t id);
+
+        // numeric id of a command, e.g. for the binary protocol, COMMAND_ID_NONE if not found
+        uint16_t get_command_id(string_view module_name, string_view func_name);
+
+        // dispatch also from a table built at compile time, nothing is copied
+        // attached once, RESULT_ERROR if a table is already attached
+        uint8_t attach_static(const static_module* modules, size_t count);
+
+#ifdef TINY_SHELL_STATS
+        // counters of every command that ran, one line per command
+        string get_stats();
+        void write_stats(text_sink& sink);
+        void reset_stats();
+#endif
+
+        // largest arity and argument footprint registered, used to size an arg_arena
+        size_t get_max_arity() const { return max_arity; }
+        size_t get_max_args_size() const { return max_args_size; }
 
+        // a function not 'numbered' takes no id, e.g. a built-in one that must not shift the ids of the application
         template<typename... param>
-        uint8_t add_func_to_module(string name, uint8_t(*func)(param...), string func_name, string func_description) {
-            size_t mod_idx = select_module(name);
-            if (check_index(mod_idx)) return MODULE_NOT_FOUND; // Module not found
-            return commands_array[mod_idx].add(func, func_name, func_description);
+        uint8_t add_func_to_module(string_view name, uint8_t(*func)(param...), string_view func_name, const char* func_description, bool numbered = true) {
+            table_guard guard(lock);
+            return add_func_to_module(name, make_unique<class_function<param...>>(func, names.intern(func_name), func_description), numbered);
         }
+
+        template<typename F>
+        enable_if_callable<F> add_func_to_module(string_view name, F&& func, string_view func_name, const char* func_description, bool numbered = true) {
+            typedef typename callable_traits<typename decay<F>::type>::function_type function_type;
+            table_guard guard(lock);
+            return add_func_to_module(name, make_unique<function_type>(forward<F>(func), names.intern(func_name), func_description), numbered);
+        }
+
+        uint8_t add_func_to_module(string_view name, unique_ptr<base_function> func, bool numbered = true);
+
+        // bytes taken by the interned names of the modules and functions
+        size_t get_names_size() const { return names.get_used(); }
+
+        // changes on every registration, e.g. so a cache of resolved commands knows it is stale
+        uint32_t get_generation() const { return generation.load(memory_order_acquire); }
     private:
         function_manager* commands_array;
-        string* module_name;
-        string* module_description;
+        const char** module_name;           // interned in names
+        const char** module_description;    // kept by pointer, never copied
         size_t size;
+        size_t capacity;
+        size_t max_arity = 0;
+        size_t max_args_size = 0;
+        command_index index;
+        // the dispatch reads them without the lock: the size is stored last and read first
+        atomic<const static_module*> static_modules{nullptr};
+        atomic<size_t> static_size{0};
+#ifdef TINY_SHELL_STATS
+        command_stats* static_stats = nullptr;  // one per command of the static table, in its order
+#endif
+        name_pool names;
+        atomic<base_function**> id_chunks[ID_CHUNKS] = {};
+        atomic<size_t> ids_size{0};
+        atomic<uint32_t> generation{0};
+        table_lock lock;
     
         bool check_index(size_t idx);
-        void resize(size_t new_size);
+        void reserve(size_t new_capacity);
         size_t select(string name);
-        size_t select_module(string name);
-        string get_all_module(size_t idx);
-        uint8_t create_module(size_t idx, string mod_name, string mod_description);
-
-        template<typename... param>
-        uint8_t add_func_to_module(size_t mod_idx, uint8_t(*func)(param...), string func_name, string func_description) {
-            return commands_array[mod_idx].add(func, func_name, func_description);
-        }
+        size_t select_module(string_view name);
+        const static_module* select_static_module(string_view name);
+        size_t get_static(const static_module*& modules) const;
+        command_handle static_handle(const static_command* command, size_t position) const;
+        uint8_t index_function(size_t mod_idx, bool numbered);
+        static bool id_position(size_t id, size_t& chunk, size_t& offset);
+        void write_all_module(text_sink& sink, size_t idx);
+        uint8_t create_module(size_t idx, string_view mod_name, const char* mod_description);
 };
 
 # endif
\ No newline at end of file
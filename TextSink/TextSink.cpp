@@ -0,0 +1,63 @@
+#include "TextSink.h"
+
+#include <cstring>
+
+text_sink::text_sink(sink_callback callback, void* context)
+    : callback(callback), context(context), buffer(local), capacity(TEXT_SINK_SIZE - 1), length(0), written(0) {}
+
+text_sink::text_sink(sink_callback callback, void* context, char* buffer, size_t size)
+    : callback(callback), context(context), buffer(buffer), capacity(size ? size - 1 : 0), length(0), written(0) {
+    // a buffer without room for a character falls back to the one of the sink
+    if (capacity == 0) {
+        this->buffer = local;
+        capacity = TEXT_SINK_SIZE - 1;
+    }
+}
+
+text_sink& text_sink::write(string_view text) {
+    written += text.size();
+
+    // long texts go out in as many full chunks as needed
+    while (!text.empty()) {
+        if (length == capacity) flush();
+        size_t count = capacity - length < text.size() ? capacity - length : text.size();
+        memcpy(buffer + length, text.data(), count);
+        length += count;
+        text.remove_prefix(count);
+    }
+    return *this;
+}
+
+text_sink& text_sink::write(char c) {
+    if (length == capacity) flush();
+    buffer[length++] = c;
+    written++;
+    return *this;
+}
+
+text_sink& text_sink::write_number(uint64_t value) {
+    // digits are produced backwards into a local array, no string is built
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[sizeof(digits) - ++count] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    return write(string_view(digits + sizeof(digits) - count, count));
+}
+
+void text_sink::flush() {
+    if (length == 0) return;
+    buffer[length] = '\0';
+    if (callback) callback(context, buffer, length);
+    length = 0;
+}
+
+void sink_to_string(void* context, const char* text, size_t length) {
+    static_cast<string*>(context)->append(text, length);
+}
+
+void sink_to_output(void* context, const char* text, size_t) {
+    void (*output)(const char* text) = *static_cast<void (**)(const char*)>(context);
+    if (output) output(text);
+}
@@ -0,0 +1,65 @@
+#ifndef TEXT_SINK_H
+#define TEXT_SINK_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// ****************************************
+// *   Destination of the text output     *
+// ****************************************
+
+// characters gathered by a sink before they are handed to its callback
+#ifndef TEXT_SINK_SIZE
+#define TEXT_SINK_SIZE 64
+#endif
+
+// receives one chunk of text, null terminated, with the context given to the sink
+typedef void (*sink_callback)(void* context, const char* text, size_t length);
+
+// streams text to a callback in chunks of a fixed buffer, so help, types and results
+// are written out piece by piece instead of being concatenated into a string first
+class text_sink {
+    public:
+        // chunks of the buffer of the sink itself
+        text_sink(sink_callback callback, void* context);
+
+        // chunks of a buffer of the caller, one byte of it is kept for the terminator
+        text_sink(sink_callback callback, void* context, char* buffer, size_t size);
+
+        // what is still buffered goes out
+        ~text_sink() { flush(); }
+
+        text_sink(const text_sink&) = delete;
+        text_sink& operator=(const text_sink&) = delete;
+
+        text_sink& write(string_view text);
+        text_sink& write(char c);
+        text_sink& write_number(uint64_t value);
+
+        // hand the buffered characters to the callback now
+        void flush();
+
+        // characters written since the sink was built
+        size_t get_written() const { return written; }
+
+    private:
+        sink_callback callback;
+        void* context;
+        char* buffer;
+        size_t capacity;    // characters that fit, without the terminator
+        size_t length;
+        size_t written;
+        char local[TEXT_SINK_SIZE];
+};
+
+// appends to the string* given as context
+void sink_to_string(void* context, const char* text, size_t length);
+
+// prints through the void (**)(const char*) given as context, e.g. &output of the shell
+void sink_to_output(void* context, const char* text, size_t length);
+
+#endif
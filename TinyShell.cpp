@@ -1,173 +1,703 @@
 #include <TinyShell.h>
-
-// define a macro to safely execute a command and catch exceptions
-#define SAFE_EXEC(expr) [&]() -> string { \
+#include <AsyncQueue/AsyncQueue.h>
+
+// the worker of the async commands: a FreeRTOS task on the ESP32, a thread on the host
+// elsewhere there is no worker and process_async is called by the application
+#if defined(ESP_PLATFORM)
+#define TINY_SHELL_WORKER_TASK
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#ifndef ASYNC_TASK_STACK
+#define ASYNC_TASK_STACK 4096
+#endif
+#ifndef ASYNC_TASK_PRIORITY
+#define ASYNC_TASK_PRIORITY 1
+#endif
+#elif !defined(ARDUINO)
+#define TINY_SHELL_WORKER_THREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#ifdef TINY_SHELL_NO_EXCEPTIONS
+// nothing can be thrown, the errors are already in the result
+#define SAFE_WRITE(sink, expr) expr;
+#else
+// define a macro to safely write the result of a command and catch exceptions
+#define SAFE_WRITE(sink, expr) \
     try { \
-        return expr; \
+        expr; \
     } catch (const exception& e) { \
-        return string(e.what()) + " " + string(__FUNCTION__) + " " + string(__FILE__) + ":" + to_string(__LINE__); \
+        (sink).write(e.what()).write(' ').write(__FUNCTION__).write(' ').write(__FILE__).write(':').write_number(__LINE__); \
     } catch (...) { \
-       return "Unknown error occurred in " + string(__FUNCTION__) + " " + string(__FILE__) + ":" + to_string(__LINE__); \
-    } \
-}();
+        (sink).write("Unknown error occurred in ").write(__FUNCTION__).write(' ').write(__FILE__).write(':').write_number(__LINE__); \
+    }
+#endif
 
-string TinyShell::run_line_command(string command) {
-    // remove leading and trailing whitespace
-    ParsedCommand cmd = parse_command(command);
+size_t count_commas(string_view s) {
+    // only the commas between arguments, not the ones inside an array
+    size_t count = 0;
+    for (size_t comma = arg_end(s); comma != string_view::npos; comma = arg_end(s)) {
+        s.remove_prefix(comma + 1);
+        ++count;
+    }
+    return count;
+}
+
+// call with arguments already converted, an exception is only reported by its status
+static TinyShell::CommandResult call_handle(const command_handle& handle, void** args) {
+    uint8_t code;
+#ifdef TINY_SHELL_NO_EXCEPTIONS
+    code = handle.call(args);
+#else
+    try {
+        code = handle.call(args);
+    } catch (...) {
+        return {TinyShell::COMMAND_EXCEPTION, RESULT_ERROR, 0};
+    }
+#endif
+    return {code == RESULT_OK ? TinyShell::COMMAND_OK : TinyShell::COMMAND_FAILED, code, 0};
+}
+
+string TinyShell::run_line_command(const string& command) {
+    return run_line_command(command.data(), command.size());
+}
+
+string TinyShell::run_line_command(const char* command, size_t length) {
+    string text;
+    {
+        text_sink sink(sink_to_string, &text);
+        run_line_command(command, length, sink);
+    }
+    return text;
+}
+
+void TinyShell::run_line_command(const char* command, size_t length, text_sink& sink) {
+    STATS_ONLY(stats_time parse_start = stats_now(); size_t allocs = stats_allocations();)
+
+    // split the line into views of the buffer
+    ParsedCommand cmd = parse_command(string_view(command, length));
+
+    // resolve the command once, the handle is reused until the call
+    command_handle handle = table_linker.resolve(cmd.module_name, cmd.command_name);
+
+    STATS_ONLY(stats_time parse_elapsed = stats_now() - parse_start;)
 
     // verify if the command is valid
-    string validation_error = validate_command(cmd);
-    if (!validation_error.empty())
-        return validation_error;
+    CommandResult result = validate_command(cmd, handle);
+    if (result.status != COMMAND_OK) {
+        write_result(sink, cmd, handle, result);
+        return;
+    }
 
-    // check if the module exists
-    const char** types = table_linker.get_param_types(cmd.module_name, cmd.command_name);
-    string result_text;
-    void** args = nullptr;
+    STATS_ONLY(handle.get_stats().parse.add(parse_elapsed);)
 
-    args = convert_args(cmd, types, result_text);
+    // parse the arguments straight into the parameters, call the function and stream its result
+    SAFE_WRITE(sink, write_result(sink, cmd, handle, call_command(cmd, handle)));
 
-    // if the args conversion failed, return the error message
-    if (result_text.empty())
+    STATS_ONLY(handle.get_stats().add_allocations(stats_allocations() - allocs);)
+}
+
+TinyShell::CommandResult TinyShell::run_command(const string& command) {
+    return run_command(command.data(), command.size());
+}
 
-        // try to call the command with the converted arguments
-        result_text = SAFE_EXEC([&]() -> string {
-            // call the function with the converted arguments
-            uint8_t result = call(cmd.module_name, cmd.command_name, args);
+TinyShell::CommandResult TinyShell::run_command(const char* command, size_t length) {
+    if (cache.enabled()) return run_cached(string_view(command, length));
 
-            // check the result of the command execution
-            if (result != 0)
-                return "Comando '" + cmd.command_name + "' do módulo '" + cmd.module_name + "' falhou com código de erro: " + to_string(result) + ".\n";
+    STATS_ONLY(stats_time parse_start = stats_now(); size_t allocs = stats_allocations();)
+
+    ParsedCommand cmd = parse_command(string_view(command, length));
+    command_handle handle = table_linker.resolve(cmd.module_name, cmd.command_name);
+
+    STATS_ONLY(stats_time parse_elapsed = stats_now() - parse_start;)
+
+    CommandResult result = validate_command(cmd, handle);
+    if (result.status != COMMAND_OK)
+        return result;
 
-            return "Comando '" + cmd.command_name + "' do módulo '" + cmd.module_name + "' executado com sucesso.\n";
-        }());
+    STATS_ONLY(handle.get_stats().parse.add(parse_elapsed);)
 
-    // clean up the allocated memory
-    delete[] args;
-    delete[] types;
-    
-    // return the result of the command execution
-    return result_text;
+#ifdef TINY_SHELL_NO_EXCEPTIONS
+    result = call_command(cmd, handle);
+#else
+    // only the status of an exception is kept, no text is built for it
+    try {
+        result = call_command(cmd, handle);
+    } catch (...) {
+        result = {COMMAND_EXCEPTION, RESULT_ERROR, 0};
+    }
+#endif
+
+    STATS_ONLY(handle.get_stats().add_allocations(stats_allocations() - allocs);)
+
+    return result;
 }
 
-size_t count_commas(const string& s) {
-    size_t count = 0;
-    for (char c : s) if (c == ',') ++count;
-    return count;
+TinyShell::CommandResult TinyShell::run_cached(string_view line) {
+    STATS_ONLY(stats_time parse_start = stats_now(); size_t allocs = stats_allocations();)
+
+    line = trim_blank(line);
+    uint32_t hash = hash_name(line);
+
+    // read before resolving, a registration in between leaves the entry stale and not wrong
+    uint32_t generation = table_linker.get_generation();
+    cache_entry* entry = cache.find(line, hash, generation);
+    if (entry == nullptr) {
+        ParsedCommand cmd = parse_command(line);
+        command_handle handle = table_linker.resolve(cmd.module_name, cmd.command_name);
+
+        // lines that do not run are not kept
+        CommandResult result = validate_command(cmd, handle);
+        if (result.status != COMMAND_OK) return result;
+
+        STATS_ONLY(handle.get_stats().parse.add(stats_now() - parse_start); stats_time convert_start = stats_now();)
+
+        // convert once into the entry, the arguments are reused by the next hits
+        entry = cache.insert(line, hash, generation, handle);
+        const type_tag* types = handle.get_param_types();
+        string_view args = cmd.args_str;
+        size_t converted = 0;
+        while (converted < cmd.args_count && convert_type_char(next_arg(args), types[converted], entry->arena).status == CONVERT_OK)
+            converted++;
+
+        STATS_ONLY(handle.get_stats().convert.add(stats_now() - convert_start);)
+
+        if (converted < cmd.args_count) {
+            cache.remove(entry);
+            return {COMMAND_CONVERSION_ERROR, RESULT_ERROR, static_cast<uint8_t>(converted)};
+        }
+    } else {
+        // a hit is only looked up, there is nothing to convert
+        STATS_ONLY(entry->handle.get_stats().parse.add(stats_now() - parse_start);)
+    }
+
+    CommandResult result = call_handle(entry->handle, entry->arena.get_args());
+    STATS_ONLY(entry->handle.get_stats().add_allocations(stats_allocations() - allocs);)
+    return result;
+}
+
+TinyShell::PreparedCommand TinyShell::prepare(string_view command) {
+    ParsedCommand cmd = parse_command(command);
+    return PreparedCommand(table_linker.resolve(cmd.module_name, cmd.command_name));
+}
+
+TinyShell::CommandResult TinyShell::PreparedCommand::run(string_view args) const {
+    if (!handle.valid()) return {COMMAND_NOT_FOUND, FUNCTION_NOT_FOUND, 0};
+
+    // resolved ahead, the parse is only the count of the arguments
+    STATS_ONLY(stats_time parse_start = stats_now(); size_t allocs = stats_allocations();)
+
+    args = trim_blank(args);
+    size_t args_count = args.empty() ? 0 : 1 + count_commas(args);
+    if (args_count != handle.get_size()) return {COMMAND_WRONG_ARG_COUNT, RESULT_ERROR, 0};
+
+    STATS_ONLY(handle.get_stats().parse.add(stats_now() - parse_start);)
+
+    ParsedCommand cmd = {string_view(), string_view(), args, args_count};
+    CommandResult result;
+#ifdef TINY_SHELL_NO_EXCEPTIONS
+    result = call_command(cmd, handle);
+#else
+    try {
+        result = call_command(cmd, handle);
+    } catch (...) {
+        result = {COMMAND_EXCEPTION, RESULT_ERROR, 0};
+    }
+#endif
+
+    STATS_ONLY(handle.get_stats().add_allocations(stats_allocations() - allocs);)
+
+    return result;
+}
+
+TinyShell::CommandResult TinyShell::PreparedCommand::invoke(void** args) const {
+    return call_handle(handle, args);
+}
+
+TinyShell::CommandResult TinyShell::run_binary(const uint8_t* payload, size_t length) {
+    if (length < 2) return {COMMAND_NOT_FOUND, FUNCTION_NOT_FOUND, 0};
+
+    // there is no text, the parse is the lookup of the id
+    STATS_ONLY(stats_time parse_start = stats_now(); size_t allocs = stats_allocations();)
+
+    command_handle handle = table_linker.resolve(static_cast<uint16_t>(payload[0] | (payload[1] << 8)));
+    if (!handle.valid()) return {COMMAND_NOT_FOUND, FUNCTION_NOT_FOUND, 0};
+
+    STATS_ONLY(handle.get_stats().parse.add(stats_now() - parse_start); stats_time convert_start = stats_now();)
+
+    // the arguments are copied in their native encoding, following the parameter types
+    binary_arena.reserve(handle.get_args_size(), handle.get_size());
+    const type_tag* types = handle.get_param_types();
+    const uint8_t* data = payload + 2;
+    const uint8_t* end = payload + length;
+    size_t converted = 0;
+    while (converted < handle.get_size() && binary_converters[types[converted]](data, end, binary_arena).status == CONVERT_OK)
+        converted++;
+
+    STATS_ONLY(handle.get_stats().convert.add(stats_now() - convert_start);)
+
+    if (converted < handle.get_size()) {
+        binary_arena.reset();
+        return {COMMAND_CONVERSION_ERROR, RESULT_ERROR, static_cast<uint8_t>(converted)};
+    }
+
+    // bytes left over are arguments the function does not take
+    CommandResult result = (data == end) ? call_handle(handle, binary_arena.get_args()) : CommandResult{COMMAND_WRONG_ARG_COUNT, RESULT_ERROR, 0};
+    binary_arena.reset();
+
+    STATS_ONLY(handle.get_stats().add_allocations(stats_allocations() - allocs);)
+
+    return result;
+}
+
+uint16_t TinyShell::get_command_id(string_view module_name, string_view command_name) {
+    return table_linker.get_command_id(module_name, command_name);
+}
+
+vector<TinyShell::CommandResult> TinyShell::run_script(const char* script, size_t length, bool stop_on_error) {
+    const char* end = script + length;
+
+    // one allocation for the results, sized by the number of lines, a final newline starts no line
+    size_t lines = length && script[length - 1] != '\n' ? 1 : 0;
+    for (const char* p = script; (p = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr; p++) lines++;
+
+    vector<CommandResult> results;
+    results.reserve(lines);
+
+    for (const char* line = script; line < end; ) {
+        const char* newline = static_cast<const char*>(memchr(line, '\n', end - line));
+        const char* line_end = newline ? newline : end;
+
+        string_view text = trim_blank(string_view(line, line_end - line));
+        if (text.empty() || text.front() == '#') {
+            results.push_back({COMMAND_EMPTY, RESULT_OK, 0});
+        } else {
+            CommandResult result = run_command(text.data(), text.size());
+            results.push_back(result);
+            if (stop_on_error && result.status != COMMAND_OK) break;
+        }
+
+        if (!newline) break;
+        line = newline + 1;
+    }
+
+    return results;
 }
 
-TinyShell::ParsedCommand TinyShell::parse_command(const string& command) {
+TinyShell::CommandResult TinyShell::call_command(const ParsedCommand& cmd, const command_handle& handle) {
+    uint8_t code = 0;
+    size_t failed_arg = 0;
+
+    // the function times its own execution, the rest of parse_call is the conversion
+    STATS_ONLY(stats_last_execute = 0; stats_time call_start = stats_now();)
+    bool parsed = handle.parse_call(cmd.args_str, code, failed_arg);
+    STATS_ONLY(handle.get_stats().convert.add(stats_now() - call_start - stats_last_execute);)
+
+    if (!parsed) return {COMMAND_CONVERSION_ERROR, RESULT_ERROR, static_cast<uint8_t>(failed_arg)};
+    return {code == RESULT_OK ? COMMAND_OK : COMMAND_FAILED, code, 0};
+}
+
+string TinyShell::format_result(string_view command, const CommandResult& result) {
+    string text;
+    {
+        text_sink sink(sink_to_string, &text);
+        write_result(sink, command, result);
+    }
+    return text;
+}
+
+void TinyShell::write_result(text_sink& sink, string_view command, const CommandResult& result) {
+    // parse and resolve again, the result does not keep views of the line
+    ParsedCommand cmd = parse_command(command);
+    write_result(sink, cmd, table_linker.resolve(cmd.module_name, cmd.command_name), result);
+}
+
+void TinyShell::write_result(text_sink& sink, const ParsedCommand& cmd, const command_handle& handle, const CommandResult& result) {
+    switch (result.status) {
+        case COMMAND_MODULE_NOT_FOUND:
+            sink.write("Module '").write(cmd.module_name).write("' not found.\n\n");
+            table_linker.write_all(sink);
+            return;
+        case COMMAND_NOT_FOUND:
+            sink.write("Command '").write(cmd.command_name).write("' not found in module '").write(cmd.module_name).write("'\n\n");
+            table_linker.write_all_module(sink, cmd.module_name);
+            return;
+        // the types are only known while the line still resolves to its command, a binary result has no line
+        case COMMAND_WRONG_ARG_COUNT:
+            if (handle.valid()) handle.write_expected_types(sink);
+            else sink.write("Wrong number of arguments");
+            return;
+        case COMMAND_CONVERSION_ERROR: {
+            // walk to the argument that failed, only on the error path
+            string_view args = cmd.args_str;
+            string_view arg;
+            for (size_t i = 0; i <= result.failed_arg; i++) arg = next_arg(args);
+            if (cmd.args_str.empty()) sink.write("Error converting argument ").write_number(result.failed_arg);
+            else sink.write("Error converting argument '").write(arg).write('\'');
+            if (handle.valid() && result.failed_arg < handle.get_size())
+                sink.write(" to type '").write(type_code_str[handle.get_param_types()[result.failed_arg]]).write('\'');
+            return;
+        }
+        case COMMAND_EXCEPTION:
+            sink.write("Comando '").write(cmd.command_name).write("' do módulo '").write(cmd.module_name).write("' lançou uma exceção.\n");
+            return;
+        case COMMAND_EMPTY:
+            return;
+        case COMMAND_QUEUED:
+            sink.write("Comando '").write(cmd.command_name).write("' do módulo '").write(cmd.module_name).write("' na fila.\n");
+            return;
+        case COMMAND_QUEUE_FULL:
+            sink.write("Fila cheia, comando '").write(cmd.command_name).write("' do módulo '").write(cmd.module_name).write("' descartado.\n");
+            return;
+        case COMMAND_FAILED:
+            sink.write("Comando '").write(cmd.command_name).write("' do módulo '").write(cmd.module_name).write("' falhou com código de erro: ").write_number(result.code).write(".\n");
+            return;
+        default:
+            sink.write("Comando '").write(cmd.command_name).write("' do módulo '").write(cmd.module_name).write("' executado com sucesso.\n");
+            return;
+    }
+}
+
+TinyShell::ParsedCommand TinyShell::parse_command(string_view command) {
     ParsedCommand result;
+    command = trim_blank(command);
 
     // get the module name
     size_t space_pos = command.find(' ');
-    result.module_name = (space_pos == string::npos) ? command : command.substr(0, space_pos);
+    result.module_name = (space_pos == string_view::npos) ? command : command.substr(0, space_pos);
 
     // verify if the module name is empty
     size_t command_start = command.find('-');
-    if (command_start == string::npos) {
-        result.command_name = "";
-        result.args_str = "";
+    if (command_start == string_view::npos) {
+        result.command_name = string_view();
+        result.args_str = string_view();
         result.args_count = 0;
         return result;
     }
 
     // find the command name and arguments
     size_t command_end = command.find(' ', command_start);
-    if (command_end == string::npos) command_end = command.length();
+    if (command_end == string_view::npos) command_end = command.length();
 
     // extract the command name
     result.command_name = command.substr(command_start + 1, command_end - command_start - 1);
 
     if (command_end < command.length()) {
-        result.args_str = command.substr(command_end + 1);
+        result.args_str = trim_blank(command.substr(command_end + 1));
         result.args_count = result.args_str.empty() ? 0 : 1 + count_commas(result.args_str);
     } else {
-        result.args_str = "";
+        result.args_str = string_view();
         result.args_count = 0;
     }
 
     return result;
 }
 
-string TinyShell::validate_command(const ParsedCommand& cmd) {
-    if (!check_module_name(cmd.module_name))
-        return "Module '" + cmd.module_name + "' not found.\n\n" + get_help();
+TinyShell::CommandResult TinyShell::validate_command(const ParsedCommand& cmd, const command_handle& handle) {
+    if (!handle.valid()) {
+        // only the error path looks the module up again, to tell what is missing
+        if (!table_linker.check_module_name(cmd.module_name))
+            return {COMMAND_MODULE_NOT_FOUND, MODULE_NOT_FOUND, 0};
+        return {COMMAND_NOT_FOUND, FUNCTION_NOT_FOUND, 0};
+    }
+
+    if (cmd.args_count != handle.get_size())
+        return {COMMAND_WRONG_ARG_COUNT, RESULT_ERROR, 0};
+
+    return {COMMAND_OK, RESULT_OK, 0};
+}
+
+string TinyShell::get_help(const string& module_name) {
+    if (module_name.empty()) return table_linker.get_all();
+    else return table_linker.get_all_module(module_name);
+}
+
+void TinyShell::write_help(text_sink& sink, string_view module_name) {
+    if (module_name.empty()) table_linker.write_all(sink);
+    else table_linker.write_all_module(sink, module_name);
+}
 
-    if (!check_function_name(cmd.module_name, cmd.command_name))
-        return "Command '" + cmd.command_name + "' not found in module '" + cmd.module_name + "'\n\n" +
-               get_help(cmd.module_name);
+uint8_t TinyShell::create_module(string_view mod_name, const char* mod_description) {
+    return table_linker.create_module(mod_name, mod_description);
+}
 
-    if (!check_expected_types(cmd.module_name, cmd.command_name, cmd.args_count))
-        return get_expected_types(cmd.module_name, cmd.command_name);
+void TinyShell::set_output(void (*output)(const char* text)) {
+    this->output = output;
+    reader.set_echo(echo ? output : nullptr);
+}
 
-    return "";
+void TinyShell::set_echo(bool enable) {
+    echo = enable;
+    reader.set_echo(echo ? output : nullptr);
 }
 
-void** TinyShell::convert_args(const ParsedCommand& cmd, const char** types, string& error_msg) {
-    if (cmd.args_count == 0 || types == nullptr) return nullptr;
+void TinyShell::feed(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) feed(data[i]);
+}
+
+void TinyShell::feed(char c) {
+    if (!reader.feed(c)) return;
+
+    if (reader.overflowed()) {
+        if (output) output("Line too long, dropped.\n");
+        return;
+    }
+
+    // empty lines (e.g. a lone enter) run nothing
+    string_view line = trim_blank(reader.get_line());
+    if (line.empty()) return;
 
-    void** args = new void*[cmd.args_count];
-    size_t pos = 0;
+    // the result goes out in chunks as it is written
+    text_sink sink(sink_to_output, &output);
+    run_line_command(line.data(), line.size(), sink);
+}
 
-    // split the args_str by commas and convert each argument to the corresponding type
-    for (size_t i = 0; i < cmd.args_count; ++i) {
-        size_t next_pos = cmd.args_str.find(',', pos);
-        if (next_pos == string::npos) next_pos = cmd.args_str.length();
+#ifdef TINY_SHELL_STATS
+uint8_t TinyShell::register_stats() {
+    uint8_t result = create_module("stats", "contadores e latencias dos comandos");
+    if (result != RESULT_OK) return result;
+
+    // registered first but without ids, the commands of the application get the same ids with or without the stats
+    table_linker.add_func_to_module("stats", [this]() -> uint8_t {
+        if (output == nullptr) return RESULT_ERROR;
+        text_sink sink(sink_to_output, &output);
+        write_stats(sink);
+        return RESULT_OK;
+    }, "l", "Lista os contadores dos comandos executados", false);
+
+    table_linker.add_func_to_module("stats", [this]() -> uint8_t {
+        reset_stats();
+        return RESULT_OK;
+    }, "r", "Zera os contadores", false);
+
+    return RESULT_OK;
+}
 
-        // get the argument substring
-        string arg = cmd.args_str.substr(pos, next_pos - pos);
+string TinyShell::get_stats() {
+    return table_linker.get_stats();
+}
 
-        // remove leading and trailing whitespace from the argument
-        arg.erase(0, arg.find_first_not_of(' '));
-        arg.erase(arg.find_last_not_of(' ') + 1);
+void TinyShell::write_stats(text_sink& sink) {
+    table_linker.write_stats(sink);
+}
 
-        // convert the argument to the corresponding type using safe conversion
-        void* ptr = nullptr;
-        string result_text = SAFE_EXEC([&]() -> string {
-            ptr = convert_type_char(arg.c_str(), types[i]);
-            if (ptr == nullptr)
-                error_msg = "Error converting argument '" + arg + "' to type '" + types[i] + "'";
-            return "";
-        }());
+void TinyShell::reset_stats() {
+    table_linker.reset_stats();
+}
+#endif
 
-        if (!result_text.empty())
-            // break the loop if an error occurred during conversion
-            break;
+uint8_t TinyShell::attach_static(const static_module* modules, size_t count) {
+    return table_linker.attach_static(modules, count);
+}
+
+void TinyShell::reserve(size_t modules, size_t commands) {
+    table_linker.reserve(modules, commands);
+}
 
-        args[i] = ptr;
-        pos = next_pos + 1;
+void TinyShell::enable_cache(size_t entries) {
+    cache.resize(entries);
+}
+
+// ****************************************
+// *        Async commands                *
+// ****************************************
+
+// a command converted by the producer, waiting for the worker
+struct AsyncJob {
+    command_handle handle;
+    arg_arena arena;
+    uint32_t ticket = 0;
+    TinyShell::AsyncCallback done = nullptr;
+};
+
+// result of an ended ticket, read by poll_async while the worker may write the next one
+// the ticket is cleared while the result changes, so a reader sees a torn write as a mismatch
+struct AsyncResult {
+    atomic<uint32_t> ticket{0};
+    atomic<uint32_t> packed{0};
+};
+
+struct TinyShell::AsyncState {
+    spsc_queue<AsyncJob, ASYNC_QUEUE_SIZE> queue;
+    AsyncResult results[ASYNC_QUEUE_SIZE];
+    uint32_t next_ticket = 0;       // only used by the producer
+    atomic<uint32_t> completed{0};  // last ticket that ended, they end in order
+    atomic<bool> stop{false};
+    atomic<bool> running{false};    // from start_worker until the worker ended
+#if defined(TINY_SHELL_WORKER_THREAD)
+    thread worker;
+    mutex lock;                     // only to sleep, the queue itself has no lock
+    condition_variable wake;
+#elif defined(TINY_SHELL_WORKER_TASK)
+    atomic<TaskHandle_t> worker{nullptr};   // known before start_worker returns
+#endif
+
+    // wake the worker after a publish or a stop
+    void notify() {
+#if defined(TINY_SHELL_WORKER_THREAD)
+        { lock_guard<mutex> guard(lock); }
+        wake.notify_one();
+#elif defined(TINY_SHELL_WORKER_TASK)
+        TaskHandle_t task = worker.load();
+        if (task) xTaskNotifyGive(task);
+#endif
     }
+};
 
-    return args;
+TinyShell::~TinyShell() {
+    stop_worker();
+    delete async;
 }
 
-string TinyShell::get_help(string module_name) {
-    if (module_name.empty()) return table_linker.get_all();
-    else return table_linker.get_all_module(module_name);
+TinyShell::AsyncState& TinyShell::get_async() {
+    if (!async) async = new AsyncState();
+    return *async;
 }
 
-bool TinyShell::check_module_name(string module_name) {
-    return table_linker.check_module_name(module_name);
+TinyShell::CommandResult TinyShell::run_async(const char* command, size_t length, uint32_t& ticket, AsyncCallback done) {
+    AsyncState& state = get_async();
+
+    // resolved and converted here, so the errors come back right away and the worker only calls
+    ParsedCommand cmd = parse_command(string_view(command, length));
+    command_handle handle = table_linker.resolve(cmd.module_name, cmd.command_name);
+    CommandResult result = validate_command(cmd, handle);
+    if (result.status != COMMAND_OK) return result;
+
+    AsyncJob* job = state.queue.producer_slot();
+    if (job == nullptr) return {COMMAND_QUEUE_FULL, RESULT_ERROR, 0};
+
+    job->arena.reserve(handle.get_args_size(), handle.get_size());
+    const type_tag* types = handle.get_param_types();
+    string_view args = cmd.args_str;
+    for (size_t i = 0; i < cmd.args_count; i++) {
+        if (convert_type_char(next_arg(args), types[i], job->arena).status != CONVERT_OK) {
+            job->arena.reset();
+            return {COMMAND_CONVERSION_ERROR, RESULT_ERROR, static_cast<uint8_t>(i)};
+        }
+    }
+
+    // 0 is never a ticket
+    if (++state.next_ticket == 0) state.next_ticket = 1;
+    ticket = state.next_ticket;
+    job->handle = handle;
+    job->ticket = ticket;
+    job->done = done;
+
+    state.queue.publish();
+    state.notify();
+    return {COMMAND_QUEUED, RESULT_OK, 0};
 }
 
-bool TinyShell::check_function_name(string module_name, string func_name) {
-    return table_linker.check_function_name(module_name, func_name);
+TinyShell::CommandResult TinyShell::poll_async(uint32_t ticket) {
+    if (!async || ticket == 0) return {COMMAND_NOT_FOUND, FUNCTION_NOT_FOUND, 0};
+
+    // the tickets end in order, so the ones after the last ended are still queued
+    if (static_cast<int32_t>(ticket - async->completed.load(memory_order_acquire)) > 0)
+        return {COMMAND_QUEUED, RESULT_OK, 0};
+
+    // sequentially consistent, so a result changed between the two loads of the ticket is noticed
+    AsyncResult& slot = async->results[ticket & (ASYNC_QUEUE_SIZE - 1)];
+    uint32_t before = slot.ticket.load();
+    uint32_t packed = slot.packed.load();
+    if (before != ticket || slot.ticket.load() != ticket)
+        return {COMMAND_EMPTY, RESULT_OK, 0};
+
+    return {static_cast<CommandStatus>(packed & 0xFF), static_cast<uint8_t>(packed >> 8), static_cast<uint8_t>(packed >> 16)};
 }
 
-string TinyShell::get_expected_types(string module_name, string func_name){
-    return table_linker.get_expected_types_str(module_name, func_name);
+size_t TinyShell::process_async(size_t max_jobs) {
+    // the worker is the only consumer while it runs
+    if (!async || async->running.load()) return 0;
+    return drain_async(max_jobs);
 }
 
-uint8_t TinyShell::create_module(string mod_name, string mod_description) {
-    return table_linker.create_module(mod_name, mod_description);
+size_t TinyShell::drain_async(size_t max_jobs) {
+    AsyncState& state = *async;
+
+    size_t ran = 0;
+    while (ran < max_jobs) {
+        AsyncJob* job = state.queue.consumer_slot();
+        if (job == nullptr) break;
+
+        CommandResult result = call_handle(job->handle, job->arena.get_args());
+        uint32_t ticket = job->ticket;
+        AsyncCallback done = job->done;
+        job->arena.reset();
+        state.queue.release();
+
+        AsyncResult& slot = state.results[ticket & (ASYNC_QUEUE_SIZE - 1)];
+        slot.ticket.store(0);
+        slot.packed.store(result.status | (result.code << 8) | (result.failed_arg << 16));
+        slot.ticket.store(ticket);
+        state.completed.store(ticket, memory_order_release);
+
+        if (done) done(ticket, result);
+        ran++;
+    }
+    return ran;
 }
 
-bool TinyShell::check_expected_types(string module_name, string command_name, size_t args_count) {
-    // Check if the module and command exist
-    return table_linker.check_expected_types(module_name, command_name, args_count);
+bool TinyShell::start_worker() {
+#if defined(TINY_SHELL_WORKER_THREAD)
+    AsyncState& state = get_async();
+    if (state.running.load()) return true;
+
+    state.stop = false;
+    state.running = true;
+    state.worker = thread([this, &state]() {
+        while (!state.stop.load()) {
+            drain_async(SIZE_MAX);
+            unique_lock<mutex> lock(state.lock);
+            state.wake.wait(lock, [&state]() { return state.stop.load() || !state.queue.empty(); });
+        }
+    });
+    return true;
+#elif defined(TINY_SHELL_WORKER_TASK)
+    AsyncState& state = get_async();
+    if (state.running.load()) return true;
+
+    // running before the task exists, so a second start or a stop right after sees it
+    state.stop = false;
+    state.running = true;
+    auto task = [](void* shell) {
+        AsyncState& state = *static_cast<TinyShell*>(shell)->async;
+        // also set by start_worker, here in case a publish comes before it returns
+        state.worker = xTaskGetCurrentTaskHandle();
+        while (!state.stop.load()) {
+            static_cast<TinyShell*>(shell)->drain_async(SIZE_MAX);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        state.worker = nullptr;
+        state.running = false;
+        vTaskDelete(nullptr);
+    };
+
+    TaskHandle_t handle = nullptr;
+    if (xTaskCreate(task, "tinyshell", ASYNC_TASK_STACK, this, ASYNC_TASK_PRIORITY, &handle) != pdPASS) {
+        state.running = false;
+        return false;
+    }
+    state.worker = handle;
+    return true;
+#else
+    return false;
+#endif
 }
 
-uint8_t TinyShell::call(string module_name, string func_name, void** args) {
-    return table_linker.call(module_name, func_name, args);
-}
\ No newline at end of file
+void TinyShell::stop_worker() {
+    if (!async) return;
+#if defined(TINY_SHELL_WORKER_THREAD)
+    if (!async->running.load()) return;
+    async->stop = true;
+    async->notify();
+    async->worker.join();
+    async->running = false;
+#elif defined(TINY_SHELL_WORKER_TASK)
+    if (!async->running.load()) return;
+    async->stop = true;
+    async->notify();
+    while (async->running.load()) vTaskDelay(1);
+#endif
+}
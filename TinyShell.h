@@ -2,10 +2,21 @@
 #define TINY_SHELL_H
 
 #include <TableLinker/TableLinker.h>
+#include <CommandCache/CommandCache.h>
+#include <BinaryProtocol/BinaryProtocol.h>
+#include <LineReader/LineReader.h>
 #include <string>
+#include <string_view>
+#include <vector>
 
 using namespace std;
 
+// without exceptions (e.g. -fno-exceptions) nothing is caught and errors are only return codes
+// define TINY_SHELL_NO_EXCEPTIONS to drop the try/catch even when the toolchain has exceptions
+#if !defined(TINY_SHELL_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS)
+#define TINY_SHELL_NO_EXCEPTIONS
+#endif
+
 // **********************************
 // *       Class of TinyShell       *
 // **********************************
@@ -14,8 +25,8 @@ using namespace std;
 // and run the command with the args
 
 // The command is a function pointer that is registered in the TableLinker
-// The args are converted to the correct type and passed to the function pointer
-// The args are passed as a void** pointer, so the function can receive any type of args
+// The args are parsed straight into the parameter types of the function and passed to it
+// The TableLinker also accepts the args as a void** pointer, so the function can receive any type of args
 // The function pointer is registered in the TableLinker with the name and description
 // The module is registered in the TableLinker with the name and description
 // The module can have multiple functions registered in it  
@@ -24,27 +35,268 @@ using namespace std;
 
 /**
  * @brief TinyShell class provides a shell-like interface for managing modules and commands.
+ *
+ * run_line_command, run_command without the cache, prepare, PreparedCommand and get_help may be
+ * called from many tasks at once and during the registrations; the cache, run_binary, feed and
+ * run_async use buffers of the shell and must stay in one context, the registrations may still
+ * come from other tasks.
  */
 class TinyShell {
     public:
         /**
          * @brief Default constructor for TinyShell.
          */
-        TinyShell() {}
+        TinyShell() {
+            STATS_ONLY(register_stats();)
+        }
+
+        /**
+         * @brief Builds a shell that dispatches from a table declared at compile time.
+         * @param modules Static table of modules, kept by pointer and never copied.
+         */
+        template<size_t N>
+        explicit TinyShell(const static_module (&modules)[N]) {
+            table_linker.attach_static(modules, N);
+            STATS_ONLY(register_stats();)
+        }
+
+        ~TinyShell();
+
+        // the table and the worker are owned by the shell
+        TinyShell(const TinyShell&) = delete;
+        TinyShell& operator=(const TinyShell&) = delete;
+
+        /*
+            @brief dispatch also from a table declared at compile time, nothing is copied
+            @param modules: static table of modules, must outlive the shell
+            @param count: number of modules in the table
+            @return return RESULT_ERROR if a table is already attached, it is never replaced
+        */
+        uint8_t attach_static(const static_module* modules, size_t count);
 
         /*
             @brief helper to know about the module
             @param module_name: name of the module to get help, if empty return all modules
             @return return all itens inside the module
         */
-        string get_help(string module_name = "");
+        string get_help(const string& module_name = "");
+
+        /*
+            @brief stream the help to a sink, in chunks, without building the text
+            @param sink: where the text goes, e.g. a text_sink over the output or a socket
+            @param module_name: name of the module to get help, if empty all modules
+        */
+        void write_help(text_sink& sink, string_view module_name = "");
 
         /*
             @brief run a command line
             @param command: the command line to run
             @return return the result of the function
         */
-        string run_line_command(string command);
+        string run_line_command(const string& command);
+
+        /*
+            @brief run a command line straight from a buffer, without copying it
+            @param command: the command line to run, does not need to be null terminated
+            @param length: the number of characters of the command line
+            @return return the result of the function
+        */
+        string run_line_command(const char* command, size_t length);
+
+        /*
+            @brief run a command line and stream its result to a sink, nothing is concatenated
+            @param command: the command line to run, does not need to be null terminated
+            @param length: the number of characters of the command line
+            @param sink: where the text of the result goes
+        */
+        void run_line_command(const char* command, size_t length, text_sink& sink);
+
+        enum CommandStatus : uint8_t {
+            COMMAND_OK,                 // the function ran and returned RESULT_OK
+            COMMAND_FAILED,             // the function ran and returned an error code
+            COMMAND_MODULE_NOT_FOUND,
+            COMMAND_NOT_FOUND,          // the module exists, the command does not
+            COMMAND_WRONG_ARG_COUNT,
+            COMMAND_CONVERSION_ERROR,   // failed_arg is the argument that did not convert
+            COMMAND_EXCEPTION,          // the function threw, never with TINY_SHELL_NO_EXCEPTIONS
+            COMMAND_EMPTY,              // blank or comment line of a script, nothing ran
+            COMMAND_QUEUED,             // waiting for the async worker
+            COMMAND_QUEUE_FULL          // the async queue had no free slot, nothing ran
+        };
+
+        // compact result of a command, no text is built for it
+        struct CommandResult {
+            CommandStatus status;
+            uint8_t code;       // value returned by the function, or the TableLinker error code
+            uint8_t failed_arg; // index of the argument, on COMMAND_CONVERSION_ERROR
+        };
+
+        /*
+            @brief run a command line in machine mode, without building any message
+            @param command: the command line to run, does not need to be null terminated
+            @param length: the number of characters of the command line
+            @return return the status, the code returned by the function and the failing argument
+        */
+        CommandResult run_command(const char* command, size_t length);
+
+        /*
+            @brief run a command line in machine mode, without building any message
+            @param command: the command line to run
+            @return return the status, the code returned by the function and the failing argument
+        */
+        CommandResult run_command(const string& command);
+
+        // a command resolved once and run many times, skipping the lookup and the validation of the names
+        // it stays valid while the shell lives, registrations do not move the functions
+        class PreparedCommand {
+            public:
+                PreparedCommand() = default;
+
+                /*
+                    @brief tell if the command was found by prepare
+                    @return return true if the command can be run
+                */
+                bool valid() const { return handle.valid(); }
+
+                /*
+                    @brief run the command with new argument text
+                    @param args: the arguments as in a command line, e.g. "1, 2.5, abc"
+                    @return return the status, the code returned by the function and the failing argument
+                */
+                CommandResult run(string_view args) const;
+
+                /*
+                    @brief run the command with typed values, through the void** call
+                    @param values: one value per parameter, with the exact parameter type (e.g. uint8_t(1) for u1)
+                    @return return the status, the code returned by the function and the argument of the wrong type
+                */
+                template<typename... A>
+                CommandResult call(A... values) const {
+                    if (!handle.valid()) return {COMMAND_NOT_FOUND, FUNCTION_NOT_FOUND, 0};
+                    if (sizeof...(A) != handle.get_size()) return {COMMAND_WRONG_ARG_COUNT, RESULT_ERROR, 0};
+
+                    // the values are passed as they are, so their types must match exactly
+                    constexpr type_tag tags[] = {type_tag_of<A>()..., TYPE_UNKNOWN};
+                    const type_tag* types = handle.get_param_types();
+                    for (size_t i = 0; i < sizeof...(A); i++)
+                        if (tags[i] != types[i] || tags[i] == TYPE_UNKNOWN)
+                            return {COMMAND_CONVERSION_ERROR, RESULT_ERROR, static_cast<uint8_t>(i)};
+
+                    void* args[] = {static_cast<void*>(&values)..., nullptr};
+                    return invoke(args);
+                }
+
+            private:
+                friend class TinyShell;
+                explicit PreparedCommand(const command_handle& handle) : handle(handle) {}
+
+                CommandResult invoke(void** args) const;
+
+                command_handle handle;
+        };
+
+        // called by the worker when an async command ends, in the context of the worker
+        typedef void (*AsyncCallback)(uint32_t ticket, const CommandResult& result);
+
+        /*
+            @brief resolve and convert a command line now and queue it for the worker, without waiting for it
+            @param command: the command line to run, does not need to be null terminated
+            @param length: the number of characters of the command line
+            @param ticket: set to the ticket of the queued command, to poll it
+            @param done: called by the worker when the command ends, may be nullptr
+            @return return COMMAND_QUEUED, COMMAND_QUEUE_FULL, or the error found before queueing
+            @note only one context may queue commands
+        */
+        CommandResult run_async(const char* command, size_t length, uint32_t& ticket, AsyncCallback done = nullptr);
+
+        /*
+            @brief state of an async command
+            @param ticket: the ticket given by run_async
+            @return return COMMAND_QUEUED while it waits or runs, its result when it ended,
+                    or COMMAND_EMPTY if it ended more than ASYNC_QUEUE_SIZE commands ago and the result was dropped
+        */
+        CommandResult poll_async(uint32_t ticket);
+
+        /*
+            @brief run the queued commands in the calling context, the pump when there is no worker
+            @param max_jobs: the most commands to run
+            @return return the number of commands that ran, always 0 while the worker runs, the queue has one consumer
+        */
+        size_t process_async(size_t max_jobs = SIZE_MAX);
+
+        /*
+            @brief start the worker that runs the queued commands (a thread on the host, a task on FreeRTOS)
+            @return return false if there is no worker on this platform, call process_async instead
+        */
+        bool start_worker();
+
+        /*
+            @brief stop the worker after the command it is running, the queued ones stay queued
+        */
+        void stop_worker();
+
+        /*
+            @brief resolve a command once, to run it many times
+            @param command: the module and the command, e.g. "module -func", arguments are ignored
+            @return return the prepared command, check valid() before running it
+        */
+        PreparedCommand prepare(string_view command);
+
+        /*
+            @brief run a command received in binary, with the arguments copied as they are and no text involved
+            @param payload: the payload of a frame (e.g. from a frame_reader), the command id followed by the arguments
+            @param length: the number of bytes of the payload
+            @return return the status, the code returned by the function and the argument that did not decode
+            @note not reentrant, a command must not run binary commands itself
+        */
+        CommandResult run_binary(const uint8_t* payload, size_t length);
+
+        /*
+            @brief numeric id of a command, used by the binary frames
+            @param module_name: the name of the module
+            @param command_name: the name of the command
+            @return return the id, COMMAND_ID_NONE if the command is not found
+        */
+        uint16_t get_command_id(string_view module_name, string_view command_name);
+
+        /*
+            @brief run many newline separated command lines from one buffer, in machine mode
+            @param script: the lines to run, split in place without copies, blank lines and lines starting with '#' are skipped
+            @param length: the number of characters of the buffer
+            @param stop_on_error: stop at the first line that does not run with COMMAND_OK
+            @return return one result per line, in order, up to the line that stopped the script, none for an empty buffer
+        */
+        vector<CommandResult> run_script(const char* script, size_t length, bool stop_on_error = false);
+
+        /*
+            @brief keep the last command lines run by run_command compiled, a repeated line skips parsing, lookup and conversion
+            @param entries: number of lines kept, the least recently used is replaced, 0 turns the cache off
+            @note the cached arguments are reused, so the functions must not change arguments taken by reference
+            @note a line is resolved again after any registration, also one made through get_table()
+        */
+        void enable_cache(size_t entries);
+
+        /*
+            @brief the cache of command lines, with its hit and miss counters
+            @return return the cache
+        */
+        const command_cache& get_cache() const { return cache; }
+
+        /*
+            @brief build the message of a result only when it is needed
+            @param command: the command line that produced the result
+            @param result: the result returned by run_command
+            @return return the same message run_line_command would return
+        */
+        string format_result(string_view command, const CommandResult& result);
+
+        /*
+            @brief stream the message of a result to a sink
+            @param sink: where the message goes
+            @param command: the command line that produced the result
+            @param result: the result returned by run_command
+        */
+        void write_result(text_sink& sink, string_view command, const CommandResult& result);
 
         /*
             @brief add a function to a module
@@ -55,89 +307,157 @@ class TinyShell {
             @return return the result of the function
         */
         template<typename... param>
-        uint8_t add(uint8_t(*func)(param...), string name, string description, string module_name) {
+        uint8_t add(uint8_t(*func)(param...), string_view name, const char* description, string_view module_name) {
             return table_linker.add_func_to_module(module_name, func, name, description);
         }
 
+        /*
+            @brief add a callable with captures (lambda, functor) to a module
+            @param func: the callable to add, stored inline up to CALLABLE_INLINE_SIZE bytes
+            @param name: the name of the function
+            @param description: the description of the function
+            @param module_name: the name of the module
+            @return return the result of the function
+        */
+        template<typename F>
+        enable_if_callable<F> add(F&& func, string_view name, const char* description, string_view module_name) {
+            return table_linker.add_func_to_module(module_name, forward<F>(func), name, description);
+        }
+
         /*
             @brief create a module
             @param mod_name: the name of the module
             @param mod_description: the description of the module
             @return return the result of the function
         */
-        uint8_t create_module(string mod_name, string mod_description);
-    private:
-        TableLinker table_linker;
+        uint8_t create_module(string_view mod_name, const char* mod_description);
+
+        /*
+            @brief reserve space for the modules and commands before registering them
+            @param modules: number of modules expected
+            @param commands: number of commands expected, across all modules
+        */
+        void reserve(size_t modules, size_t commands = 0);
+
+        // the views point into the command line, which must outlive them
         struct ParsedCommand {
-            string module_name;
-            string command_name;
-            string args_str;
+            string_view module_name;
+            string_view command_name;
+            string_view args_str;
             size_t args_count;
         };
 
         /**
-         * @brief Parses a command string into its components.
+         * @brief Parses a command string into its components without copying it.
          * @param command The command string to parse.
          * @return ParsedCommand structure containing parsed data.
          */
-        ParsedCommand parse_command(const string& command);
+        static ParsedCommand parse_command(string_view command);
 
-        /**
-         * @brief Validates a parsed command.
-         * @param cmd The parsed command to validate.
-         * @return Error message if invalid, empty string if valid.
-         */
-        string validate_command(const ParsedCommand& cmd);
+        /*
+            @brief feed received characters, each completed line runs right away and its result goes to the output
+            @param data: the characters received, e.g. from Serial, in any amount
+            @param length: the number of characters
+        */
+        void feed(const char* data, size_t length);
+
+        /*
+            @brief feed one received character, the line runs when it is completed
+            @param c: the character received
+        */
+        void feed(char c);
+
+        /*
+            @brief echo the characters fed to the shell through the output, as a terminal does
+            @param enable: true to echo, false to stay quiet (e.g. when a program sends the lines)
+        */
+        void set_echo(bool enable);
+
+        /*
+            @brief set where the built-in modules (e.g. stats) and the lines fed to the shell write their text
+            @param output: function that prints a null terminated text, e.g. to Serial
+        */
+        void set_output(void (*output)(const char* text));
+
+#ifdef TINY_SHELL_STATS
+        /*
+            @brief counters of the commands that ran, also listed by the built-in "stats -l"
+            @return one line per command with calls, parse/convert/execute times and allocations
+        */
+        string get_stats();
+
+        /*
+            @brief stream the counters of the commands to a sink, as "stats -l" does
+            @param sink: where the text goes
+        */
+        void write_stats(text_sink& sink);
+
+        /*
+            @brief reset the counters of every command, also done by "stats -r"
+        */
+        void reset_stats();
+#endif
 
         /**
-         * @brief Converts command arguments to appropriate types.
-         * @param cmd The parsed command containing arguments.
-         * @param types Array of expected argument types.
-         * @param error_msg Reference to error message string.
-         * @return Array of converted arguments as void pointers.
+         * @brief Gives access to the table, e.g. to resolve commands directly.
+         * @return The TableLinker of the shell.
          */
-        void** convert_args(const ParsedCommand& cmd, const char** types, string& error_msg);
+        TableLinker& get_table() { return table_linker; }
+    private:
+        TableLinker table_linker;
+        void (*output)(const char* text) = nullptr;
+        command_cache cache;
+        arg_arena binary_arena;
+        line_reader reader;
+        bool echo = false;
 
+        // queue and worker of the async commands, created by the first use
+        struct AsyncState;
+        AsyncState* async = nullptr;
+        AsyncState& get_async();
+
+        /** run the queued commands, in the only consumer of the queue */
+        size_t drain_async(size_t max_jobs);
+
+#ifdef TINY_SHELL_STATS
         /**
-         * @brief Checks if the received argument types match the expected types for a function.
-         * @param module_name Name of the module.
-         * @param func_name Name of the function.
-         * @param receive Number of received arguments.
-         * @return True if types match, false otherwise.
+         * @brief Registers the built-in stats module.
+         * @return Result of the registration.
          */
-        bool check_expected_types(string module_name, string func_name, size_t receive);
+        uint8_t register_stats();
+#endif
 
         /**
-         * @brief Checks if a module name exists.
-         * @param module_name Name of the module to check.
-         * @return True if module exists, false otherwise.
+         * @brief Validates a parsed command against its resolved handle.
+         * @param cmd The parsed command to validate.
+         * @param handle The command resolved from the table, invalid if not found.
+         * @return COMMAND_OK if the command can be called, the reason otherwise.
          */
-        bool check_module_name(string module_name);
+        CommandResult validate_command(const ParsedCommand& cmd, const command_handle& handle);
 
         /**
-         * @brief Checks if a function name exists within a module.
-         * @param module_name Name of the module.
-         * @param func_name Name of the function to check.
-         * @return True if function exists, false otherwise.
+         * @brief Runs a command line through the cache, compiling it on a miss.
+         * @param line The command line to run.
+         * @return Result of the conversion and of the function.
          */
-        bool check_function_name(string module_name, string func_name);
+        CommandResult run_cached(string_view line);
 
         /**
-         * @brief Gets the expected argument types for a function in a module.
-         * @param module_name Name of the module.
-         * @param func_name Name of the function.
-         * @return String describing expected types.
+         * @brief Converts the arguments and calls a validated command.
+         * @param cmd The parsed command, with the arguments text.
+         * @param handle The command resolved from the table.
+         * @return Result of the conversion and of the function.
          */
-        string get_expected_types(string module_name, string func_name);
+        static CommandResult call_command(const ParsedCommand& cmd, const command_handle& handle);
 
         /**
-         * @brief Calls a function within a module with given arguments.
-         * @param module_name Name of the module.
-         * @param func_name Name of the function.
-         * @param args Arguments to pass to the function.
-         * @return Result of the function call.
+         * @brief Streams the message of a result.
+         * @param sink Where the message goes.
+         * @param cmd The parsed command that produced the result.
+         * @param handle The command resolved from the table, invalid if not found.
+         * @param result The result to describe.
          */
-        uint8_t call(string module_name, string func_name, void** args = nullptr);
+        void write_result(text_sink& sink, const ParsedCommand& cmd, const command_handle& handle, const CommandResult& result);
     };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,239 @@
+// host microbenchmarks of the command pipeline
+// measures parse_command, name resolution, argument conversion, call, run_line_command, run_command,
+// run_binary and run_script
+// across table sizes and argument counts, reporting ns/op and allocations/op
+//
+// usage: tinyshell_bench [min_time_ms_per_case]
+
+#include <TinyShell.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// ****************************************
+// *   Counting of the heap allocations   *
+// ****************************************
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* ptr = malloc(size ? size : 1);
+#ifdef TINY_SHELL_NO_EXCEPTIONS
+    if (ptr == nullptr) abort();
+#else
+    if (ptr == nullptr) throw bad_alloc();
+#endif
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+// ****************************************
+// *      Commands used by the bench      *
+// ****************************************
+
+static volatile uint32_t sink = 0;
+
+uint8_t bench_0() { sink = sink + 1; return RESULT_OK; }
+uint8_t bench_1(int32_t a) { sink = sink + a; return RESULT_OK; }
+uint8_t bench_3(int32_t a, float b, uint8_t c) { sink = sink + a + (uint32_t)b + c; return RESULT_OK; }
+uint8_t bench_6(int32_t a, float b, uint8_t c, double d, char e, string f) {
+    sink = sink + a + (uint32_t)b + c + (uint32_t)d + e + f.size();
+    return RESULT_OK;
+}
+
+struct bench_case {
+    size_t args;
+    const char* line;
+};
+
+static const bench_case cases[] = {
+    {0, "bench -a0"},
+    {1, "bench -a1 42"},
+    {3, "bench -a3 42, 3.5, 7"},
+    {6, "bench -a6 42, 3.5, 7, 2.25, x, hello"},
+};
+
+static const size_t table_sizes[] = {10, 100, 1000, 10000};
+
+// ****************************************
+// *             Measurement              *
+// ****************************************
+
+struct measure_result {
+    double ns;
+    double allocs;
+};
+
+static double min_time_ms = 200.0;
+
+// double the batch until it runs for min_time_ms, then report per operation
+template<typename F>
+measure_result measure(F&& body) {
+    body();  // warm up
+
+    size_t iterations = 16;
+    while (true) {
+        size_t allocs_before = allocations;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) body();
+        auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+        if (elapsed >= min_time_ms * 1e6 || iterations >= (size_t(1) << 30))
+            return {elapsed / iterations, double(allocations - allocs_before) / iterations};
+        iterations *= 2;
+    }
+}
+
+static void report(const char* name, size_t table, size_t args, const measure_result& result) {
+    printf("%-18s %8zu %5zu %12.1f %10.2f\n", name, table, args, result.ns, result.allocs);
+}
+
+// table with 'commands' functions spread in modules of 10, plus the bench module
+static void fill_table(TinyShell& shell, size_t commands) {
+    shell.reserve(commands / 10 + 2, commands + 4);
+
+    // "mod" or "c" and the digits of any size_t
+    char module[24];
+    char name[24];
+    for (size_t i = 0; i < commands; i++) {
+        snprintf(module, sizeof(module), "mod%zu", i / 10);
+        snprintf(name, sizeof(name), "c%zu", i % 10);
+        if (i % 10 == 0) shell.create_module(module, "filler module");
+        shell.add(bench_1, name, "filler command", module);
+    }
+
+    shell.create_module("bench", "bench module");
+    shell.add(bench_0, "a0", "no arguments", "bench");
+    shell.add(bench_1, "a1", "one argument", "bench");
+    shell.add(bench_3, "a3", "three arguments", "bench");
+    shell.add(bench_6, "a6", "six arguments", "bench");
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) min_time_ms = atof(argv[1]);
+
+    STATS_ONLY(set_stats_alloc_counter([]() -> size_t { return allocations; });)
+
+    printf("%-18s %8s %5s %12s %10s\n", "benchmark", "table", "args", "ns/op", "allocs/op");
+
+    // parsing does not depend on the table
+    for (const bench_case& test : cases) {
+        string_view line(test.line);
+        report("parse_command", 0, test.args, measure([&] {
+            TinyShell::ParsedCommand cmd = TinyShell::parse_command(line);
+            sink = sink + cmd.args_count;
+        }));
+    }
+
+    for (size_t table_size : table_sizes) {
+        TinyShell shell;
+        fill_table(shell, table_size);
+        TableLinker& table = shell.get_table();
+
+        // resolve names spread over the whole table
+        vector<string> modules;
+        vector<string> names;
+        for (size_t i = 0; i < 64; i++) {
+            size_t command = (i * 7919) % table_size;
+            modules.push_back("mod" + to_string(command / 10));
+            names.push_back("c" + to_string(command % 10));
+        }
+        size_t next = 0;
+        report("resolve", table_size, 0, measure([&] {
+            command_handle handle = table.resolve(modules[next], names[next]);
+            sink = sink + handle.valid();
+            next = (next + 1) & 63;
+        }));
+
+        for (const bench_case& test : cases) {
+            TinyShell::ParsedCommand cmd = TinyShell::parse_command(test.line);
+            command_handle handle = table.resolve(cmd.module_name, cmd.command_name);
+            const type_tag* types = handle.get_param_types();
+
+            // text to void** in an arena, the path used by TableLinker::call
+            arg_arena arena;
+            arena.reserve(table.get_max_args_size(), table.get_max_arity());
+            report("convert_args", table_size, test.args, measure([&] {
+                string_view args = cmd.args_str;
+                for (size_t i = 0; i < cmd.args_count; i++)
+                    convert_type_char(next_arg(args), types[i], arena);
+                arena.reset();
+            }));
+
+            // call with arguments already converted
+            string_view args = cmd.args_str;
+            for (size_t i = 0; i < cmd.args_count; i++)
+                convert_type_char(next_arg(args), types[i], arena);
+            void** converted = arena.get_args();
+            report("call", table_size, test.args, measure([&] {
+                sink = sink + handle.call(converted);
+            }));
+            arena.reset();
+
+            // typed invoker, conversion and call together
+            report("parse_call", table_size, test.args, measure([&] {
+                uint8_t result = 0;
+                size_t failed_arg = 0;
+                handle.parse_call(cmd.args_str, result, failed_arg);
+                sink = sink + result;
+            }));
+
+            // prepared once, then run with the argument text
+            TinyShell::PreparedCommand prepared = shell.prepare(test.line);
+            report("prepared.run", table_size, test.args, measure([&] {
+                sink = sink + prepared.run(cmd.args_str).code;
+            }));
+
+            // whole pipeline, including the result string
+            report("run_line_command", table_size, test.args, measure([&] {
+                string result = shell.run_line_command(test.line, strlen(test.line));
+                sink = sink + result.size();
+            }));
+
+            // whole pipeline in machine mode, no text is built
+            report("run_command", table_size, test.args, measure([&] {
+                TinyShell::CommandResult result = shell.run_command(test.line, strlen(test.line));
+                sink = sink + result.code;
+            }));
+
+            // the same line again and again, served by the cache of compiled lines
+            shell.enable_cache(8);
+            report("run_command/cache", table_size, test.args, measure([&] {
+                TinyShell::CommandResult result = shell.run_command(test.line, strlen(test.line));
+                sink = sink + result.code;
+            }));
+            shell.enable_cache(0);
+        }
+
+        // the three argument case as a binary frame, received byte by byte and run without text
+        uint8_t frame[32];
+        size_t frame_size = encode_frame(frame, sizeof(frame), shell.get_command_id("bench", "a3"), int32_t(42), 3.5f, uint8_t(7));
+        frame_reader reader;
+        report("run_binary", table_size, 3, measure([&] {
+            for (size_t i = 0; i < frame_size; i++)
+                if (reader.feed(frame[i])) sink = sink + shell.run_binary(reader.get_payload(), reader.get_payload_size()).code;
+        }));
+
+        // the four cases as a script of 100 lines, reported per line
+        string script;
+        for (size_t i = 0; i < 100; i++) script += string(cases[i % 4].line) + "\n";
+        measure_result per_script = measure([&] {
+            vector<TinyShell::CommandResult> results = shell.run_script(script.data(), script.size());
+            sink = sink + results.size();
+        });
+        report("run_script/line", table_size, 0, {per_script.ns / 100, per_script.allocs / 100});
+    }
+
+    return 0;
+}
@@ -76,6 +76,10 @@ void setup() {
     Serial.begin(921600);
     delay(1000);
 
+    // where the shell writes the results, and echo of what is typed on the terminal
+    ts.set_output([](const char* text) { Serial.print(text); });
+    ts.set_echo(true);
+
     // create the modules
     ts.create_module("teste", "Funcoes de teste com texto");
     ts.create_module("help", "ajuda e informacoes");
@@ -90,50 +94,13 @@ void setup() {
     ts.add(wrapper_e, "e", "Explica o uso do comando", "help");
 }
 
-String commandBuffer = "";
-
 void loop() {
 
-    // the code below reads commands from the serial port
-    // it has nothing to do with the shell itself
-    // you can remove it if you want to use the shell in another way
-    // you just need to send a string formatted as "<module> -<command> [args]\n"
-
-    while (Serial.available()) {
-        char c = Serial.read();
-
-        // detects if the character is a control character
-        if (c == 8 || c == 127) {  // backspace/delete
-            if (!commandBuffer.isEmpty()) {
-                commandBuffer.remove(commandBuffer.length() - 1);
-
-                // deletes the last character from the serial output
-                Serial.print("\b \b");
-            }
-            continue;
-        }
-
-        // echo the character to the serial output
-        Serial.write(c);
+    // the shell reads the lines itself: feed it the characters as they arrive
+    // it handles backspace and echo, and runs each line as soon as it is completed
+    // the results are written through the output set in setup, nothing here waits
+    // you can feed it from any other source (TCP, BLE, ...) the same way
 
-        // end of command detection
-        if (c == '\n') {
-            commandBuffer.trim();  // remove leading/trailing whitespace
-            Serial.println();      // new line for better readability
-
-            Serial.println("Received command: " + commandBuffer);
-
-            // run the command in the shell
-            string response = ts.run_line_command(commandBuffer.c_str());
-
-            delay(100);  // give some time for the shell to process the command
-            Serial.println(String(response.c_str()));
-
-            commandBuffer = "";
-        } else {
-            commandBuffer += c;
-        }
-    }
-
-    delay(10);
-}
\ No newline at end of file
+    while (Serial.available())
+        ts.feed(static_cast<char>(Serial.read()));
+}
@@ -0,0 +1,99 @@
+// host tests of the arrays in the text: the count of their items and their parsing
+// built twice on x86, once with the SSE2 counting and once without it, so the 8 byte SWAR path runs too
+//
+// usage: array_items_test, exits with 1 on the first failed check
+
+#include <TableLinker/TableLinker.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(expr) do { if (!(expr)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); exit(1); } } while (0)
+
+// one byte at a time, what the block paths must agree with
+static size_t reference_count(const string& items) {
+    size_t count = 0;
+    bool previous = true;
+    for (char c : items) {
+        bool separator = is_item_separator(c);
+        if (!separator && previous) count++;
+        previous = separator;
+    }
+    return count;
+}
+
+// ****************************************
+// *               Tests                  *
+// ****************************************
+
+static void test_count_items() {
+    CHECK(count_array_items("") == 0);
+    CHECK(count_array_items(" , \t\r\n,") == 0);
+    CHECK(count_array_items("1") == 1);
+    CHECK(count_array_items("1,2,3") == 3);
+    CHECK(count_array_items(" 1 ,, 2\t3\r\n4 ") == 4);
+
+    // an item across the end of a block, the first block of 8 and of 16 bytes
+    CHECK(count_array_items("1234567 89") == 2);
+    CHECK(count_array_items("12345678 9") == 2);
+    CHECK(count_array_items("123456789012345 67") == 2);
+    CHECK(count_array_items("1234567890123456 7") == 2);
+    CHECK(count_array_items("       ,1234567890123456789012345") == 1);
+
+    // bytes close to the separators, or with the high bit set, are items
+    CHECK(count_array_items("-+./\x1f!\xac\xa0\x8d") == 1);
+    CHECK(count_array_items("a\xac b\xa0 c\x8a d\x89 e\xff f") == 6);
+}
+
+static void test_count_patterns() {
+    // every pattern of items and separators, at every length around the blocks
+    const char alphabet[] = {'7', ' ', ',', '\t', '\r', '\n', '\xac', '-'};
+    uint32_t state = 12345;
+    for (size_t length = 0; length <= 70; length++) {
+        for (int round = 0; round < 200; round++) {
+            string items;
+            for (size_t i = 0; i < length; i++) {
+                state = state * 1103515245u + 12345u;
+                items += alphabet[(state >> 16) % sizeof(alphabet)];
+            }
+            CHECK(count_array_items(items) == reference_count(items));
+        }
+    }
+}
+
+static void test_parse_arrays() {
+    vector<int32_t> values;
+    CHECK(parse_arg(string_view("[1,2,3]"), values) && values == vector<int32_t>({1, 2, 3}));
+    CHECK(parse_arg(string_view("[ 1 2\t3 ]"), values) && values == vector<int32_t>({1, 2, 3}));
+    CHECK(parse_arg(string_view("[1,, 2 ,3,]"), values) && values == vector<int32_t>({1, 2, 3}));
+    CHECK(parse_arg(string_view("[]"), values) && values.empty());
+    CHECK(parse_arg(string_view("[ , ]"), values) && values.empty());
+
+    // a bad item or a missing bracket fails the whole array
+    CHECK(!parse_arg(string_view("[1 x 3]"), values));
+    CHECK(!parse_arg(string_view("[1 2 3"), values));
+    CHECK(!parse_arg(string_view("1 2 3]"), values));
+    CHECK(!parse_arg(string_view("["), values));
+    CHECK(!parse_arg(string_view("[99999999999]"), values));
+
+    // a long array is reserved once for all of its items
+    string text = "[";
+    for (int32_t i = 0; i < 1000; i++) text += to_string(i) + (i % 3 ? " " : ", ");
+    text += "]";
+    CHECK(parse_arg(string_view(text), values) && values.size() == 1000 && values.capacity() == 1000);
+    CHECK(values.front() == 0 && values.back() == 999);
+
+    vector<double> reals;
+    CHECK(parse_arg(string_view("[1.5 -2e3, .25]"), reals) && reals == vector<double>({1.5, -2000.0, 0.25}));
+    CHECK(!parse_arg(string_view("[1.5 inf]"), reals));
+}
+
+int main() {
+    test_count_items();
+    test_count_patterns();
+    test_parse_arrays();
+    printf("array_items_test: ok\n");
+    return 0;
+}
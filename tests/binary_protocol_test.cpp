@@ -0,0 +1,182 @@
+// host tests of the binary frames: encoding, crc, arrays and the resync of frame_reader
+// after a bad crc, a stray sync, a truncated frame and noise
+//
+// usage: binary_protocol_test, exits with 1 on the first failed check
+
+#include <BinaryProtocol/BinaryProtocol.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#define CHECK(expr) do { if (!(expr)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); exit(1); } } while (0)
+
+// ****************************************
+// *          Helpers of the tests        *
+// ****************************************
+
+// frame of the command 'id' with one i4 argument
+static vector<uint8_t> make_frame(uint16_t id, int32_t value) {
+    uint8_t buffer[16];
+    size_t length = encode_frame(buffer, sizeof(buffer), id, value);
+    return vector<uint8_t>(buffer, buffer + length);
+}
+
+static void append(vector<uint8_t>& stream, const vector<uint8_t>& bytes) {
+    stream.insert(stream.end(), bytes.begin(), bytes.end());
+}
+
+// ids of the frames delivered by a reader fed with 'stream', byte by byte
+static vector<uint16_t> read_ids(frame_reader& reader, const vector<uint8_t>& stream) {
+    vector<uint16_t> ids;
+    for (uint8_t byte : stream) {
+        for (bool complete = reader.feed(byte); complete; complete = reader.next()) {
+            CHECK(reader.get_payload_size() == 6);
+            const uint8_t* payload = reader.get_payload();
+            ids.push_back(static_cast<uint16_t>(payload[0] | (payload[1] << 8)));
+        }
+    }
+    return ids;
+}
+
+static vector<uint16_t> sequence(uint16_t first, uint16_t count) {
+    vector<uint16_t> ids;
+    for (uint16_t i = 0; i < count; i++) ids.push_back(first + i);
+    return ids;
+}
+
+// ****************************************
+// *               Tests                  *
+// ****************************************
+
+static void test_encoding() {
+    // crc16-ccitt of the standard check string
+    CHECK(crc16(reinterpret_cast<const uint8_t*>("123456789"), 9) == 0x29B1);
+
+    // sync, length, id and arguments little-endian, then the crc of the length and the payload
+    uint8_t buffer[32];
+    size_t length = encode_frame(buffer, sizeof(buffer), 0x0102, int32_t(-2), uint8_t(7), "ab", true);
+    CHECK(length == FRAME_OVERHEAD + 2 + 4 + 1 + 3 + 1);
+    const uint8_t payload[] = {0x02, 0x01, 0xFE, 0xFF, 0xFF, 0xFF, 7, 2, 'a', 'b', 1};
+    CHECK(buffer[0] == FRAME_SYNC && buffer[1] == sizeof(payload));
+    CHECK(memcmp(buffer + 2, payload, sizeof(payload)) == 0);
+    uint16_t crc = crc16(buffer + 1, 1 + sizeof(payload));
+    CHECK(buffer[length - 2] == (crc & 0xFF) && buffer[length - 1] == (crc >> 8));
+
+    // a buffer too small gives no frame
+    CHECK(encode_frame(buffer, 8, 1, int32_t(1), int32_t(2)) == 0);
+
+    // the arguments decode back through the table of their tags
+    const uint8_t* data = buffer + 4;
+    const uint8_t* end = buffer + 2 + sizeof(payload);
+    arg_arena arena;
+    arena.reserve(64, 4);
+    CHECK(*static_cast<int32_t*>(binary_converters[TYPE_I4](data, end, arena).ptr) == -2);
+    CHECK(*static_cast<uint8_t*>(binary_converters[TYPE_U1](data, end, arena).ptr) == 7);
+    CHECK(*static_cast<string*>(binary_converters[TYPE_S0](data, end, arena).ptr) == "ab");
+    CHECK(*static_cast<bool*>(binary_converters[TYPE_B1](data, end, arena).ptr));
+    CHECK(data == end && binary_converters[TYPE_I4](data, end, arena).status == CONVERT_INVALID);
+    arena.reset();
+}
+
+static void test_clean_stream() {
+    vector<uint8_t> stream;
+    for (uint16_t id = 0; id < 20; id++) append(stream, make_frame(id, -id));
+
+    frame_reader reader;
+    CHECK(read_ids(reader, stream) == sequence(0, 20));
+    CHECK(reader.get_errors() == 0);
+}
+
+static void test_bad_crc() {
+    vector<uint8_t> stream;
+    append(stream, make_frame(1, 10));
+    vector<uint8_t> bad = make_frame(2, 20);
+    bad.back() ^= 0xFF;
+    append(stream, bad);
+    append(stream, make_frame(3, 30));
+
+    frame_reader reader;
+    CHECK(read_ids(reader, stream) == vector<uint16_t>({1, 3}));
+    CHECK(reader.get_errors() == 1);
+}
+
+static void test_stray_sync() {
+    // the stray sync takes the sync of the next frame as its length, 169 bytes of frame:
+    // nothing comes out before they are all received, then every frame among them comes back
+    vector<uint8_t> stream;
+    stream.push_back(FRAME_SYNC);
+    for (uint16_t id = 0; id < 16; id++) append(stream, make_frame(id, id * 3));
+
+    frame_reader reader;
+    CHECK(read_ids(reader, stream).empty());
+    append(stream, make_frame(16, 0));
+    append(stream, make_frame(17, 0));
+    frame_reader again;
+    CHECK(read_ids(again, stream) == sequence(0, 18));
+    CHECK(again.get_errors() == 1);
+}
+
+static void test_truncated_frame() {
+    // a frame cut after its length claims the bytes of the next ones
+    vector<uint8_t> stream;
+    append(stream, make_frame(1, 1));
+    stream.push_back(FRAME_SYNC);
+    stream.push_back(200);
+    stream.push_back(0x42);
+    for (uint16_t id = 10; id < 60; id++) append(stream, make_frame(id, id));
+
+    frame_reader reader;
+    vector<uint16_t> expected = {1};
+    vector<uint16_t> rest = sequence(10, 50);
+    expected.insert(expected.end(), rest.begin(), rest.end());
+    CHECK(read_ids(reader, stream) == expected);
+    CHECK(reader.get_errors() == 1);
+}
+
+static void test_noise() {
+    // noise without syncs and a sync as the length of a dropped frame
+    vector<uint8_t> stream = {0x00, 0x13, 0xFF};
+    append(stream, make_frame(1, 1));
+    stream.push_back(FRAME_SYNC);
+    stream.push_back(FRAME_SYNC);
+    append(stream, make_frame(2, 2));
+    for (int i = 0; i < 600; i++) stream.push_back(static_cast<uint8_t>(i % FRAME_SYNC));
+    append(stream, make_frame(3, 3));
+
+    frame_reader reader;
+    CHECK(read_ids(reader, stream) == vector<uint16_t>({1, 2, 3}));
+}
+
+static void test_array_frame() {
+    uint8_t buffer[64];
+    vector<float> values = {1.5f, -2.0f, 3.25f};
+    size_t length = encode_frame(buffer, sizeof(buffer), 7, values);
+    CHECK(length == FRAME_OVERHEAD + 2 + 1 + 3 * sizeof(float));
+
+    frame_reader reader;
+    bool complete = false;
+    for (size_t i = 0; i < length; i++) complete = reader.feed(buffer[i]);
+    CHECK(complete);
+
+    const uint8_t* data = reader.get_payload() + 2;
+    const uint8_t* end = reader.get_payload() + reader.get_payload_size();
+    arg_arena arena;
+    arena.reserve(arg_size<vector<float>>(), 1);
+    convert_result result = binary_converters[TYPE_F4_ARRAY](data, end, arena);
+    CHECK(result.status == CONVERT_OK);
+    CHECK(*static_cast<vector<float>*>(result.ptr) == values);
+    CHECK(data == end);
+}
+
+int main() {
+    test_encoding();
+    test_clean_stream();
+    test_bad_crc();
+    test_stray_sync();
+    test_truncated_frame();
+    test_noise();
+    test_array_frame();
+    printf("binary_protocol_test: ok\n");
+    return 0;
+}
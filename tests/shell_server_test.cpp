@@ -0,0 +1,253 @@
+// host tests of the socket server: the replies of both modes, in order, from the loop
+// and from the workers, framing of long lines and lines past SERVER_BACKLOG_LIMIT,
+// with the loop polled from the test itself
+//
+// usage: shell_server_test, exits with 1 on the first failed check
+
+#include <ShellServer/ShellServer.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define CHECK(expr) do { if (!(expr)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); exit(1); } } while (0)
+
+static size_t last_count = 0;
+static uint8_t sum(vector<float> values) { last_count = values.size(); return RESULT_OK; }
+static uint8_t add(int32_t a, int32_t b) { return a + b == 3 ? RESULT_OK : RESULT_ERROR; }
+
+// ****************************************
+// *          Helpers of the tests        *
+// ****************************************
+
+static string socket_path(const char* name) {
+    return string("/tmp/tinyshell_test_") + name + "_" + to_string(getpid());
+}
+
+static int connect_unix(const string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(fd >= 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+    CHECK(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    return fd;
+}
+
+static size_t count_lines(const string& text) {
+    size_t lines = 0;
+    for (char c : text) lines += c == '\n';
+    return lines;
+}
+
+// sends 'text' while polling the server, then polls until 'lines' replies arrived
+static string exchange(shell_server& server, int fd, const string& text, size_t lines) {
+    size_t sent = 0;
+    string reply;
+    for (int round = 0; round < 100000; round++) {
+        if (sent == text.size() && count_lines(reply) >= lines) break;
+        if (sent < text.size()) {
+            ssize_t count = send(fd, text.data() + sent, text.size() - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (count > 0) sent += static_cast<size_t>(count);
+        }
+        server.poll(1);
+
+        char buffer[4096];
+        ssize_t count = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (count > 0) reply.append(buffer, static_cast<size_t>(count));
+    }
+    return reply;
+}
+
+static string array_line(size_t values) {
+    string line = "m -sum [";
+    for (size_t i = 0; i < values; i++) line += to_string(i) + ".5 ";
+    return line + "]";
+}
+
+// ****************************************
+// *               Tests                  *
+// ****************************************
+
+static void test_text_mode(TinyShell& shell) {
+    string path = socket_path("text");
+    shell_server server(shell);
+    CHECK(server.listen_unix(path.c_str()));
+    int fd = connect_unix(path);
+    for (int i = 0; i < 10 && server.get_connections() == 0; i++) server.poll(1);
+    CHECK(server.get_connections() == 1);
+
+    // one reply per line, in order, the replies of run_line_command
+    string reply = exchange(server, fd, "m -add 1, 2\r\nm -add 1, 3\nm -nope\n", 3);
+    CHECK(count_lines(reply) >= 3);
+    CHECK(reply.find("sucesso") < reply.find("255"));
+    CHECK(reply.find("not found") != string::npos);
+
+    // a line split over many reads
+    string line = "m -add 1, 2\n";
+    string split_reply;
+    for (size_t i = 0; i < line.size(); i += 3) split_reply += exchange(server, fd, line.substr(i, 3), 0);
+    if (count_lines(split_reply) == 0) split_reply += exchange(server, fd, "", 1);
+    CHECK(split_reply.find("sucesso") != string::npos);
+
+    // two clients at once
+    int other = connect_unix(path);
+    CHECK(exchange(server, other, "m -add 1, 2\n", 1).find("sucesso") != string::npos);
+    close(other);
+    for (int i = 0; i < 10 && server.get_connections() != 1; i++) server.poll(1);
+    CHECK(server.get_connections() == 1);
+
+    close(fd);
+}
+
+static void test_long_lines(TinyShell& shell) {
+    string path = socket_path("long");
+    shell_server server(shell);
+    CHECK(server.listen_unix(path.c_str()));
+    int fd = connect_unix(path);
+
+    // far past the 128 bytes of the line reader of the devices, with CRLF endings
+    string reply = exchange(server, fd, array_line(100) + "\r\n" + array_line(5000) + "\r\n", 2);
+    CHECK(reply.find("too long") == string::npos);
+    CHECK(last_count == 5000);
+
+    // past SERVER_BACKLOG_LIMIT the line is dropped up to its end, the next one runs
+    string huge = "m -add " + string(SERVER_BACKLOG_LIMIT + 10000, '1') + "\n";
+    reply = exchange(server, fd, huge + "m -add 1, 2\n", 2);
+    CHECK(reply.substr(0, reply.find('\n')) == "Line too long, dropped.");
+    CHECK(reply.find("sucesso") != string::npos);
+
+    // a long line split over many reads
+    string line = array_line(300) + "\n";
+    string split_reply;
+    for (size_t i = 0; i < line.size(); i += 7) split_reply += exchange(server, fd, line.substr(i, 7), 0);
+    if (count_lines(split_reply) == 0) split_reply += exchange(server, fd, "", 1);
+    CHECK(split_reply.find("sucesso") != string::npos);
+    CHECK(last_count == 300);
+
+    // the same through the workers, the dropped line keeps its place among the replies
+    CHECK(server.start_workers(2));
+    reply = exchange(server, fd, array_line(1000) + "\n" + huge + "m -add 1, 2\n", 3);
+    CHECK(count_lines(reply) == 3);
+    CHECK(reply.find("Line too long, dropped.\n") == reply.find('\n') + 1);
+    CHECK(last_count == 1000);
+    server.stop_workers();
+
+    close(fd);
+}
+
+static void test_machine_mode(TinyShell& shell) {
+    string path = socket_path("machine");
+    shell_server server(shell, SERVER_MACHINE);
+    CHECK(server.listen_unix(path.c_str()));
+    int fd = connect_unix(path);
+
+    // every reply is "status code failed_arg"
+    string reply = exchange(server, fd, "m -add 1, 2\nm -add 1, 3\nm -add 1, x\nm -nope\n", 4);
+    CHECK(reply == "0 0 0\n1 255 0\n5 255 1\n3 254 0\n");
+
+    // the dropped line too
+    string huge = "m -add " + string(SERVER_BACKLOG_LIMIT + 10, '1') + "\n";
+    reply = exchange(server, fd, "m -add 1, 2\n" + huge + "m -add 1, x\n", 3);
+    CHECK(reply == "0 0 0\n255 255 0\n5 255 1\n");
+
+    // the same through the workers, the replies keep the order of the lines
+    CHECK(server.start_workers(2));
+    string lines, expected;
+    for (int i = 0; i < 50; i++) {
+        lines += i % 2 ? "m -add 1, 2\n" : "m -add 1, x\n";
+        expected += i % 2 ? "0 0 0\n" : "5 255 1\n";
+    }
+    CHECK(exchange(server, fd, lines, 50) == expected);
+    CHECK(exchange(server, fd, huge + "m -add 1, 2\n", 2) == "255 255 0\n0 0 0\n");
+    server.stop_workers();
+
+    close(fd);
+}
+
+static void test_unix_path(TinyShell& shell) {
+    string path = socket_path("path");
+
+    // a regular file at the path is neither removed nor replaced
+    FILE* file = fopen(path.c_str(), "w");
+    CHECK(file != nullptr);
+    fputs("keep", file);
+    fclose(file);
+    {
+        shell_server server(shell);
+        CHECK(!server.listen_unix(path.c_str()));
+    }
+    struct stat status;
+    CHECK(lstat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode));
+    unlink(path.c_str());
+
+    // the socket left by an old server is replaced
+    int old = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+    CHECK(bind(old, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    close(old);
+    {
+        shell_server server(shell);
+        CHECK(server.listen_unix(path.c_str()));
+    }
+    CHECK(lstat(path.c_str(), &status) != 0);
+}
+
+static void test_out_of_descriptors(TinyShell& shell) {
+    string path = socket_path("fds");
+    shell_server server(shell);
+    CHECK(server.listen_unix(path.c_str()));
+
+    // the clients are queued, then the limit leaves the server no descriptor to accept them
+    int clients[4];
+    for (int& fd : clients) fd = connect_unix(path);
+    rlimit saved;
+    CHECK(getrlimit(RLIMIT_NOFILE, &saved) == 0);
+    int lowest_free = dup(0);
+    close(lowest_free);
+    rlimit low = saved;
+    low.rlim_cur = static_cast<rlim_t>(lowest_free);
+    CHECK(setrlimit(RLIMIT_NOFILE, &low) == 0);
+    CHECK(dup(0) < 0 && errno == EMFILE);
+
+    // the queued connections are refused, then the loop waits instead of spinning on the listener
+    for (int i = 0; i < 5; i++) server.poll(0);
+    size_t idle = 0;
+    for (int i = 0; i < 20; i++) idle += server.poll(5);
+    CHECK(idle == 0);
+    CHECK(server.get_connections() == 0);
+
+    CHECK(setrlimit(RLIMIT_NOFILE, &saved) == 0);
+    for (int fd : clients) {
+        char c;
+        CHECK(recv(fd, &c, 1, 0) == 0);
+        close(fd);
+    }
+
+    // with descriptors again new clients are served
+    int fd = connect_unix(path);
+    CHECK(exchange(server, fd, "m -add 1, 2\n", 1).find("sucesso") != string::npos);
+    close(fd);
+}
+
+int main() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(sum, "sum", "count of the values", "m");
+    shell.add(add, "add", "sum of two", "m");
+
+    test_text_mode(shell);
+    test_long_lines(shell);
+    test_machine_mode(shell);
+    test_unix_path(shell);
+    test_out_of_descriptors(shell);
+    printf("shell_server_test: ok\n");
+    return 0;
+}
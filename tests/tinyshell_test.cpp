@@ -0,0 +1,1072 @@
+// host tests of the shell: the tables and handles of the commands, the conversion of
+// the arguments, the parsing and the results of the command lines
+//
+// usage: tinyshell_test, exits with 1 on the first failed check
+
+#include <TinyShell.h>
+#include <CommandCache/CommandCache.h>
+#include <BinaryProtocol/BinaryProtocol.h>
+#include <AsyncQueue/AsyncQueue.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(expr) do { if (!(expr)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); exit(1); } } while (0)
+
+static uint8_t add3(int32_t a, int32_t b, int32_t c) { return a + b + c == 6 ? RESULT_OK : RESULT_ERROR; }
+static uint8_t sum(vector<int32_t> values, int32_t total) {
+    int32_t result = 0;
+    for (int32_t value : values) result += value;
+    return result == total ? RESULT_OK : RESULT_ERROR;
+}
+
+static uint8_t mixed(uint8_t a, double b, string c) { return a == 1 && b == 2.5 && c == "abc" ? RESULT_OK : 7; }
+// a parameter type without parser
+struct opaque {};
+static uint8_t unsupported(int32_t, opaque) { return RESULT_OK; }
+static uint8_t first() { return 1; }
+static uint8_t second() { return 2; }
+
+// two entries share add3, each has its own counters
+static constexpr static_command static_commands[] = {
+    STATIC_COMMAND(add3, "s3", "sum of three"),
+    STATIC_COMMAND(add3, "t3", "the same sum"),
+    STATIC_COMMAND(mixed, "x", "mixed types"),
+};
+
+static constexpr static_command other_commands[] = {
+    STATIC_COMMAND(add3, "u3", "sum in another module"),
+};
+
+static constexpr static_module static_modules[] = {
+    static_module_of("s", "static module", static_commands),
+    static_module_of("o", "other static module", other_commands),
+};
+
+// counts the destructors run by the arena
+static int destroyed = 0;
+struct counted {
+    int value;
+    explicit counted(int value) : value(value) {}
+    ~counted() { destroyed++; }
+};
+
+struct too_large {
+    char bytes[80];
+};
+
+static string echoed;
+static void echo_to_string(const char* text) { echoed += text; }
+
+static bool succeeds(TinyShell& shell, const string& line) {
+    return shell.run_line_command(line).find("sucesso") != string::npos;
+}
+
+// true when the text parses into T and gives 'expected'
+template<typename T>
+static bool parses(const char* text, T expected) {
+    T value{};
+    return parse_arg(string_view(text), value) && value == expected;
+}
+
+template<typename T>
+static bool rejects(const char* text) {
+    T value{};
+    return !parse_arg(string_view(text), value);
+}
+
+// ****************************************
+// *               Tests                  *
+// ****************************************
+
+static void test_command_index() {
+    TableLinker table;
+    CHECK(table.create_module("a", "module a") == RESULT_OK);
+    CHECK(table.create_module("b", "module b") == RESULT_OK);
+
+    // enough commands for the index to grow several times
+    for (int i = 0; i < 300; i++)
+        CHECK(table.add_func_to_module(i % 2 ? "a" : "b", first, "f" + to_string(i), "") == RESULT_OK);
+    for (int i = 0; i < 300; i++) {
+        CHECK(table.find(i % 2 ? "a" : "b", "f" + to_string(i)) != nullptr);
+        CHECK(table.find(i % 2 ? "b" : "a", "f" + to_string(i)) == nullptr);
+    }
+
+    // the same name in the two modules are two commands
+    CHECK(table.add_func_to_module("a", first, "same", "") == RESULT_OK);
+    CHECK(table.add_func_to_module("b", second, "same", "") == RESULT_OK);
+    CHECK(table.call("a", "same") == 1);
+    CHECK(table.call("b", "same") == 2);
+
+    // missing names, and the module entries of the index are not commands
+    CHECK(table.find("a", "missing") == nullptr);
+    CHECK(table.find("c", "same") == nullptr);
+    CHECK(table.find("a", "") == nullptr);
+    CHECK(table.call("a", "missing") == FUNCTION_NOT_FOUND);
+    CHECK(table.call("c", "same") == MODULE_NOT_FOUND);
+    CHECK(table.check_module_name("b") && !table.check_module_name("c"));
+}
+
+static void test_command_handle() {
+    TableLinker table;
+    table.create_module("m", "test module");
+    table.add_func_to_module("m", add3, "add3", "sum of three");
+
+    command_handle handle = table.resolve("m", "add3");
+    CHECK(handle.valid());
+    CHECK(handle.get_name() == "add3");
+    CHECK(handle.get_size() == 3);
+    CHECK(handle.get_param_types()[2] == TYPE_I4);
+    CHECK(handle.get_expected_types_str() == "(i4, i4, i4)");
+
+    // the same handle calls many times with new arguments
+    int32_t a = 1, b = 2, c = 3;
+    void* args[] = {&a, &b, &c};
+    CHECK(handle.call(args) == RESULT_OK);
+    c = 4;
+    CHECK(handle.call(args) == RESULT_ERROR);
+
+    // without arguments the parameters get their default values
+    CHECK(handle.call() == RESULT_ERROR);
+
+    CHECK(!table.resolve("m", "missing").valid());
+    CHECK(!table.resolve("x", "add3").valid());
+    CHECK(!command_handle().valid());
+}
+
+static void test_arg_arena() {
+    arg_arena arena;
+    CHECK(arena.emplace<int32_t>(1) == nullptr);
+
+    arena.reserve(64, 4);
+    char* c = arena.emplace<char>('x');
+    double* d = arena.emplace<double>(2.5);
+    string* s = arena.emplace<string>("a string longer than the small buffer");
+    CHECK(c && d && s);
+    CHECK(reinterpret_cast<uintptr_t>(d) % alignof(double) == 0);
+    CHECK(arena.get_count() == 3);
+    CHECK(arena.get_args()[0] == c && arena.get_args()[1] == d && arena.get_args()[2] == s);
+    CHECK(*c == 'x' && *d == 2.5 && *s == "a string longer than the small buffer");
+
+    // past the slots or the bytes reserved nothing is built
+    CHECK(arena.emplace<counted>(4) != nullptr);
+    CHECK(arena.emplace<char>('y') == nullptr);
+    arena.reset();
+    CHECK(destroyed == 1);
+    CHECK(arena.get_count() == 0);
+    CHECK(arena.emplace<too_large>() == nullptr);
+
+    // the storage is kept, the next command builds in the same place
+    CHECK(arena.emplace<char>('z') == c);
+    arena.reset();
+
+    // growing keeps what was reserved, a smaller reserve does not shrink it
+    arena.reserve(256, 8);
+    arena.reserve(8, 1);
+    for (int i = 0; i < 8; i++) CHECK(arena.emplace<counted>(i) != nullptr);
+    arena.reset();
+    CHECK(destroyed == 9);
+}
+
+static void test_converters() {
+    CHECK(type_tag_of<uint8_t>() == TYPE_U1 && type_tag_of<int32_t>() == TYPE_I4);
+    CHECK(type_tag_of<double>() == TYPE_F8 && type_tag_of<string>() == TYPE_S0);
+    CHECK(type_tag_of<int64_t>() == TYPE_I8 && type_tag_of<bool>() == TYPE_B1);
+    CHECK(type_tag_of<opaque>() == TYPE_UNKNOWN);
+    CHECK(strcmp(type_code<float>(), "f4") == 0 && strcmp(type_code_str[TYPE_C1], "c1") == 0);
+
+    // one converter per tag, the text is not null terminated
+    arg_arena arena;
+    arena.reserve(128, 8);
+    string_view line("200 -7 1.5 0.25 q text", 22);
+    CHECK(*static_cast<uint8_t*>(convert_type_char(line.substr(0, 3), TYPE_U1, arena).ptr) == 200);
+    CHECK(*static_cast<int32_t*>(convert_type_char(line.substr(4, 2), TYPE_I4, arena).ptr) == -7);
+    CHECK(*static_cast<float*>(convert_type_char(line.substr(7, 3), TYPE_F4, arena).ptr) == 1.5f);
+    CHECK(*static_cast<double*>(convert_type_char(line.substr(11, 4), TYPE_F8, arena).ptr) == 0.25);
+    CHECK(*static_cast<char*>(convert_type_char(line.substr(16, 1), TYPE_C1, arena).ptr) == 'q');
+    CHECK(*static_cast<string*>(convert_type_char(line.substr(18), TYPE_S0, arena).ptr) == "text");
+    CHECK(arena.get_count() == 6);
+    arena.reset();
+
+    // failures are statuses, nothing throws
+    CHECK(convert_type_char("1", TYPE_UNKNOWN, arena).status == CONVERT_UNKNOWN_TYPE);
+    arg_arena empty;
+    convert_result result = convert_type_char("1", TYPE_I4, empty);
+    CHECK(result.status == CONVERT_NO_SPACE && result.ptr == nullptr);
+}
+
+static void test_parse_call() {
+    TableLinker table;
+    table.create_module("m", "test module");
+    table.add_func_to_module("m", mixed, "mixed", "mixed types");
+    table.add_func_to_module("m", unsupported, "wide", "a type without parser");
+
+    // the text is parsed straight into the parameters of the function
+    uint8_t result = RESULT_ERROR;
+    size_t failed_arg = 0;
+    command_handle handle = table.resolve("m", "mixed");
+    CHECK(handle.parse_call("1, 2.5, abc", result, failed_arg) && result == RESULT_OK);
+    CHECK(handle.parse_call("1,2.5,abd", result, failed_arg) && result == 7);
+
+    // a parameter without parser fails at its index, the function is not called
+    result = RESULT_OK;
+    CHECK(!table.resolve("m", "wide").parse_call("1, 2", result, failed_arg));
+    CHECK(failed_arg == 1 && result == RESULT_OK);
+}
+
+static void test_callables() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+
+    // lambdas without and with captures, and a functor, parse their parameters like functions
+    int32_t total = 0;
+    CHECK(shell.add([](int32_t a, int32_t b) -> uint8_t { return a == b ? RESULT_OK : RESULT_ERROR; },
+                    "same", "two equal values", "m") == RESULT_OK);
+    CHECK(shell.add([&total](int32_t value, string name) -> uint8_t { total += value; return name == "x" ? RESULT_OK : 9; },
+                    "acc", "adds to the total", "m") == RESULT_OK);
+    struct scaled {
+        int32_t factor;
+        uint8_t operator()(int32_t value) { return static_cast<uint8_t>(value * factor); }
+    };
+    CHECK(shell.add(scaled{3}, "scaled", "three times the value", "m") == RESULT_OK);
+
+    CHECK(succeeds(shell, "m -same 4, 4"));
+    CHECK(shell.run_line_command("m -same 4, 5").find("255") != string::npos);
+    CHECK(succeeds(shell, "m -acc 5, x"));
+    CHECK(shell.run_line_command("m -acc 6, y").find("9") != string::npos);
+    CHECK(total == 11);
+    CHECK(shell.run_line_command("m -scaled 7").find("21") != string::npos);
+    CHECK(shell.run_line_command("m -scaled").find("(i4)") != string::npos);
+}
+
+static void test_table_growth() {
+    TableLinker table;
+    table.create_module("m0", "first module");
+    table.add_func_to_module("m0", add3, "add3", "sum of three");
+    base_function* registered = table.find("m0", "add3");
+    command_handle handle = table.resolve("m0", "add3");
+
+    // the functions are moved, never cloned, while the modules and the commands grow
+    for (int i = 1; i < 100; i++) table.create_module("m" + to_string(i), "");
+    for (int i = 0; i < 500; i++) table.add_func_to_module("m" + to_string(i % 100), first, "f" + to_string(i), "");
+    CHECK(table.find("m0", "add3") == registered);
+    CHECK(table.find("m99", "f499") != nullptr);
+
+    int32_t a = 1, b = 2, c = 3;
+    void* args[] = {&a, &b, &c};
+    CHECK(handle.call(args) == RESULT_OK);
+
+    // a shell reserved up front registers the same
+    TinyShell shell;
+    shell.reserve(4, 64);
+    shell.create_module("m", "test module");
+    for (int i = 0; i < 64; i++) shell.add(add3, "add" + to_string(i), "", "m");
+    CHECK(succeeds(shell, "m -add63 1, 2, 3"));
+}
+
+static void test_static_table() {
+    TinyShell shell(static_modules);
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+
+    // resolved by name next to the runtime modules
+    CHECK(succeeds(shell, "m -f3 1, 2, 3"));
+    CHECK(succeeds(shell, "s -s3 1, 2, 3"));
+    CHECK(succeeds(shell, "s -t3 1, 2, 3"));
+    CHECK(succeeds(shell, "s -x 1, 2.5, abc"));
+    CHECK(shell.run_line_command("o -u3 1, 2, 4").find("255") != string::npos);
+    CHECK(shell.run_line_command("s -s3 1, 2").find("(i4, i4, i4)") != string::npos);
+    CHECK(shell.run_line_command("s -nope").find("not found") != string::npos);
+    CHECK(shell.run_line_command("o -s3 1, 2, 3").find("not found") != string::npos);
+
+    // the handle of an entry types and calls it like a registered function
+    TableLinker table;
+    table.attach_static(static_modules, 2);
+    command_handle handle = table.resolve("s", "x");
+    CHECK(handle.valid() && handle.get_name() == "x" && handle.get_size() == 3);
+    CHECK(handle.get_param_types()[1] == TYPE_F8);
+    uint8_t result = RESULT_ERROR;
+    size_t failed_arg = 0;
+    CHECK(handle.parse_call("1, 2.5, abc", result, failed_arg) && result == RESULT_OK);
+    int32_t a = 1, b = 2, c = 3;
+    void* args[] = {&a, &b, &c};
+    CHECK(table.resolve("o", "u3").call(args) == RESULT_OK);
+
+    // listed by the help
+    string help = shell.get_help("");
+    CHECK(help.find("m => test module") != string::npos && help.find("s => static module") != string::npos);
+    CHECK(help.find("o => other static module") != string::npos);
+    CHECK(shell.get_help("s") == "s: static module\n-s3 (i4, i4, i4) => sum of three\n-t3 (i4, i4, i4) => the same sum\n"
+                                 "-x (u1, f8, s0) => mixed types\n");
+
+#ifdef TINY_SHELL_STATS
+    // the entries bound to the same function count apart
+    shell.run_command("s -s3 1, 2, 3");
+    string stats = shell.get_stats();
+    CHECK(stats.find("s -s3: calls=2 ") != string::npos && stats.find("s -t3: calls=1 ") != string::npos);
+    CHECK(stats.find("o -u3: calls=1 ") != string::npos && stats.find("s -x: calls=1 ") != string::npos);
+    shell.reset_stats();
+    CHECK(shell.get_stats().find("calls=") == string::npos);
+#endif
+}
+
+#ifndef TINY_SHELL_NO_EXCEPTIONS
+static uint8_t throws(int32_t) { throw runtime_error("thrown by the command"); }
+#endif
+
+static void test_run_command() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+    shell.add(unsupported, "wide", "a type without parser", "m");
+#ifndef TINY_SHELL_NO_EXCEPTIONS
+    shell.add(throws, "throws", "throws", "m");
+#endif
+
+    // one status per outcome, no text built
+    TinyShell::CommandResult result = shell.run_command("m -f3 1, 2, 3");
+    CHECK(result.status == TinyShell::COMMAND_OK && result.code == RESULT_OK);
+    result = shell.run_command("m -f3 1, 2, 4");
+    CHECK(result.status == TinyShell::COMMAND_FAILED && result.code == RESULT_ERROR);
+    CHECK(shell.run_command("q -f3").status == TinyShell::COMMAND_MODULE_NOT_FOUND);
+    CHECK(shell.run_command("m -nope").status == TinyShell::COMMAND_NOT_FOUND);
+    CHECK(shell.run_command("m -f3 1, 2").status == TinyShell::COMMAND_WRONG_ARG_COUNT);
+    result = shell.run_command("m -wide 1, 2");
+    CHECK(result.status == TinyShell::COMMAND_CONVERSION_ERROR && result.failed_arg == 1);
+#ifndef TINY_SHELL_NO_EXCEPTIONS
+    CHECK(shell.run_command("m -throws 1").status == TinyShell::COMMAND_EXCEPTION);
+#endif
+
+    // the text is built from the result only when asked, the same as run_line_command
+    const char* lines[] = {"m -f3 1, 2, 3", "m -f3 1, 2, 4", "q -f3", "m -nope", "m -f3 1, 2", "m -wide 1, 2"};
+    for (const char* line : lines) CHECK(shell.format_result(line, shell.run_command(line)) == shell.run_line_command(line));
+#ifndef TINY_SHELL_NO_EXCEPTIONS
+    CHECK(shell.run_line_command("m -throws 1").find("thrown by the command") != string::npos);
+#endif
+}
+
+static void test_run_script() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+
+    // one result per line, blank and comment lines included
+    const string script = "m -z\n\n# c\nm -f3 1,2,3\r\nm -f3 1,2,4";
+    vector<TinyShell::CommandResult> results = shell.run_script(script.data(), script.size());
+    CHECK(results.size() == 5);
+    CHECK(results[0].status == TinyShell::COMMAND_NOT_FOUND);
+    CHECK(results[1].status == TinyShell::COMMAND_EMPTY);
+    CHECK(results[2].status == TinyShell::COMMAND_EMPTY);
+    CHECK(results[3].status == TinyShell::COMMAND_OK);
+    CHECK(results[4].status == TinyShell::COMMAND_FAILED);
+
+    // a final newline ends the last line instead of starting a new one
+    const string ended = script + "\n";
+    CHECK(shell.run_script(ended.data(), ended.size()).size() == 5);
+    CHECK(shell.run_script("", 0).empty());
+    CHECK(shell.run_script("\n", 1).size() == 1);
+
+    // stops at the first error
+    results = shell.run_script(script.data(), script.size(), true);
+    CHECK(results.size() == 1);
+}
+
+static void test_command_cache() {
+    TableLinker table;
+    table.create_module("m", "test module");
+    table.add_func_to_module("m", add3, "f3", "sum of three");
+    command_handle handle = table.resolve("m", "f3");
+
+    command_cache cache;
+    CHECK(!cache.enabled() && cache.insert("a", 1, 0, handle) == nullptr);
+    cache.resize(2);
+
+    // a miss, then a hit on the same entry with its arguments still converted
+    CHECK(cache.find("a", 1, 0) == nullptr);
+    cache_entry* a = cache.insert("a", 1, 0, handle);
+    CHECK(a != nullptr && a->handle.valid());
+    for (int32_t i = 0; i < 3; i++) CHECK(a->arena.emplace<int32_t>(i) != nullptr);
+    void** args = a->arena.get_args();
+    CHECK(cache.find("a", 1, 0) == a && a->arena.get_count() == 3 && a->arena.get_args() == args);
+    CHECK(cache.get_hits() == 1 && cache.get_misses() == 1);
+
+    // the same hash with another line is a miss
+    CHECK(cache.find("b", 1, 0) == nullptr);
+
+    // the least recently used line is replaced: "a" was found after "b" was inserted
+    cache_entry* b = cache.insert("b", 2, 0, handle);
+    CHECK(cache.find("a", 1, 0) == a);
+    cache_entry* c = cache.insert("c", 3, 0, handle);
+    CHECK(c == b && cache.find("b", 2, 0) == nullptr && cache.find("a", 1, 0) == a && cache.find("c", 3, 0) == c);
+
+    // the replaced entry keeps its storage, emptied for the new line
+    CHECK(c->arena.get_count() == 0 && c->line == "c");
+
+    // a line resolved in an older generation is dropped and its entry reused first
+    CHECK(cache.find("a", 1, 1) == nullptr && cache.find("a", 1, 0) == nullptr);
+    CHECK(cache.insert("d", 4, 1, handle) == a && a->arena.get_args() == args);
+
+    // a line that did not convert is given back, clear keeps the counters
+    cache.remove(c);
+    CHECK(cache.find("c", 3, 0) == nullptr);
+    uint32_t misses = cache.get_misses();
+    cache.clear();
+    CHECK(cache.find("d", 4, 1) == nullptr && cache.get_misses() == misses + 1);
+}
+
+static void test_cache_registration() {
+    TinyShell shell;
+    shell.enable_cache(4);
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+
+    // the second run of a line is a hit, run_script goes through the cache too
+    CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(shell.run_command(" m -f3 1, 2, 3\r\n").status == TinyShell::COMMAND_OK);
+    CHECK(shell.run_script("m -f3 1, 2, 3\nm -f3 1, 2, 4", 27).size() == 2);
+    CHECK(shell.get_cache().get_hits() == 2 && shell.get_cache().get_misses() == 2);
+    CHECK(shell.run_command("m -f3 1, 2, 4").status == TinyShell::COMMAND_FAILED);
+
+    // a line resolved before a registration is resolved again, also one made through the table
+    shell.get_table().add_func_to_module("m", add3, "g3", "sum of three");
+    CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(shell.get_cache().get_hits() == 3 && shell.get_cache().get_misses() == 3);
+    shell.add(add3, "h3", "sum of three", "m");
+    CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(shell.get_cache().get_hits() == 3 && shell.get_cache().get_misses() == 4);
+    shell.create_module("n", "another module");
+    CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(shell.get_cache().get_hits() == 4 && shell.get_cache().get_misses() == 5);
+
+    // lines that do not run are not kept
+    CHECK(shell.run_command("m -f3 1, x, 3").status == TinyShell::COMMAND_CONVERSION_ERROR);
+    CHECK(shell.run_command("m -f3 1, x, 3").status == TinyShell::COMMAND_CONVERSION_ERROR);
+    CHECK(shell.run_command("m -nope").status == TinyShell::COMMAND_NOT_FOUND);
+    CHECK(shell.get_cache().get_hits() == 4 && shell.get_cache().get_misses() == 8);
+
+    // another task registers while the lines run through the cache
+    thread registrar([&shell] {
+        for (int i = 0; i < 200; i++) {
+            string module = "r" + to_string(i);
+            shell.create_module(module, "registered while running");
+            shell.add(add3, "f3", "sum of three", module);
+        }
+    });
+    for (int i = 0; i < 2000; i++) {
+        CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+        CHECK(shell.run_command("m -g3 1, 2, 3").status == TinyShell::COMMAND_OK);
+    }
+    registrar.join();
+    CHECK(shell.run_command("r199 -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+}
+
+static void test_attach_static() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+
+    // attached while another task dispatches, the commands show up whole or not at all
+    // (not found in a module that exists when the table comes between the lookup and the check of the name)
+    atomic<bool> done{false};
+    thread reader([&shell, &done] {
+        while (!done) {
+            TinyShell::CommandResult result = shell.run_command("s -s3 1, 2, 3");
+            CHECK(result.status == TinyShell::COMMAND_OK || result.status == TinyShell::COMMAND_MODULE_NOT_FOUND ||
+                  result.status == TinyShell::COMMAND_NOT_FOUND);
+            CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+        }
+    });
+    this_thread::sleep_for(chrono::milliseconds(1));
+    CHECK(shell.attach_static(static_modules, 2) == RESULT_OK);
+    done = true;
+    reader.join();
+    CHECK(shell.run_command("s -s3 1, 2, 3").status == TinyShell::COMMAND_OK);
+
+    // the table is never replaced
+    CHECK(shell.attach_static(static_modules, 2) == RESULT_ERROR);
+    TinyShell built(static_modules);
+    CHECK(built.attach_static(static_modules, 2) == RESULT_ERROR);
+}
+
+static void test_prepared_command() {
+    TinyShell shell(static_modules);
+    shell.create_module("m", "test module");
+    shell.add(mixed, "x", "mixed types", "m");
+
+    // not found, nothing runs
+    TinyShell::PreparedCommand missing = shell.prepare("m -nope");
+    CHECK(!missing.valid());
+    CHECK(missing.run("1").status == TinyShell::COMMAND_NOT_FOUND);
+    CHECK(missing.call(1).status == TinyShell::COMMAND_NOT_FOUND);
+
+    // resolved once, run with new text each time, also after more registrations
+    TinyShell::PreparedCommand prepared = shell.prepare("m -x");
+    CHECK(prepared.valid());
+    for (int i = 0; i < 20; i++) shell.create_module("r" + to_string(i), "registered after prepare");
+    CHECK(prepared.run("1, 2.5, abc").status == TinyShell::COMMAND_OK);
+    CHECK(prepared.run("  1 ,2.5,abc  ").status == TinyShell::COMMAND_OK);
+    TinyShell::CommandResult failed = prepared.run("2, 2.5, abc");
+    CHECK(failed.status == TinyShell::COMMAND_FAILED && failed.code == 7);
+    CHECK(prepared.run("1, 2.5").status == TinyShell::COMMAND_WRONG_ARG_COUNT);
+    CHECK(prepared.run("").status == TinyShell::COMMAND_WRONG_ARG_COUNT);
+    TinyShell::CommandResult bad = prepared.run("1, x, abc");
+    CHECK(bad.status == TinyShell::COMMAND_CONVERSION_ERROR && bad.failed_arg == 1);
+
+    // typed values are passed as they are, so the types must be the exact ones
+    CHECK(prepared.call(uint8_t(1), 2.5, string("abc")).status == TinyShell::COMMAND_OK);
+    TinyShell::CommandResult wrong = prepared.call(1, 2.5, string("abc"));
+    CHECK(wrong.status == TinyShell::COMMAND_CONVERSION_ERROR && wrong.failed_arg == 0);
+    wrong = prepared.call(uint8_t(1), 2.5f, string("abc"));
+    CHECK(wrong.status == TinyShell::COMMAND_CONVERSION_ERROR && wrong.failed_arg == 1);
+    wrong = prepared.call(uint8_t(1), 2.5, 'a');
+    CHECK(wrong.status == TinyShell::COMMAND_CONVERSION_ERROR && wrong.failed_arg == 2);
+    CHECK(prepared.call(uint8_t(1), 2.5).status == TinyShell::COMMAND_WRONG_ARG_COUNT);
+
+    // a command of the static table prepares the same way
+    TinyShell::PreparedCommand constant = shell.prepare("s -s3");
+    CHECK(constant.valid());
+    CHECK(constant.run("1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(constant.run("1, 2, 4").status == TinyShell::COMMAND_FAILED);
+    CHECK(constant.call(int32_t(1), int32_t(2), int32_t(3)).status == TinyShell::COMMAND_OK);
+    wrong = constant.call(int32_t(1), uint32_t(2), int32_t(3));
+    CHECK(wrong.status == TinyShell::COMMAND_CONVERSION_ERROR && wrong.failed_arg == 1);
+}
+
+static void test_run_binary() {
+    TinyShell shell(static_modules);
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+    shell.add(mixed, "x", "mixed types", "m");
+
+    // runtime commands are numbered in their order, static ones from STATIC_COMMAND_ID in the order of the table
+    uint16_t f3 = shell.get_command_id("m", "f3");
+    CHECK(f3 != COMMAND_ID_NONE && shell.get_command_id("m", "x") == f3 + 1);
+    CHECK(shell.get_command_id("s", "s3") == STATIC_COMMAND_ID && shell.get_command_id("s", "x") == STATIC_COMMAND_ID + 2);
+    CHECK(shell.get_command_id("o", "u3") == STATIC_COMMAND_ID + 3);
+    CHECK(shell.get_command_id("m", "nope") == COMMAND_ID_NONE && shell.get_command_id("q", "f3") == COMMAND_ID_NONE);
+    CHECK(shell.get_table().resolve(f3).get_name() == "f3");
+    CHECK(shell.get_table().resolve(STATIC_COMMAND_ID + 3).get_name() == "u3");
+    CHECK(!shell.get_table().resolve(STATIC_COMMAND_ID + 4).valid() && !shell.get_table().resolve(f3 + 2).valid());
+
+    // the payload of a frame is the id and the arguments little-endian
+    uint8_t frame[64];
+    size_t length = encode_frame(frame, sizeof(frame), f3, int32_t(1), int32_t(2), int32_t(3));
+    CHECK(shell.run_binary(frame + 2, length - FRAME_OVERHEAD).status == TinyShell::COMMAND_OK);
+    length = encode_frame(frame, sizeof(frame), f3, int32_t(1), int32_t(2), int32_t(4));
+    CHECK(shell.run_binary(frame + 2, length - FRAME_OVERHEAD).status == TinyShell::COMMAND_FAILED);
+    length = encode_frame(frame, sizeof(frame), uint16_t(f3 + 1), uint8_t(1), 2.5, "abc");
+    CHECK(shell.run_binary(frame + 2, length - FRAME_OVERHEAD).status == TinyShell::COMMAND_OK);
+    length = encode_frame(frame, sizeof(frame), uint16_t(STATIC_COMMAND_ID), int32_t(1), int32_t(2), int32_t(3));
+    CHECK(shell.run_binary(frame + 2, length - FRAME_OVERHEAD).status == TinyShell::COMMAND_OK);
+
+    // arguments missing or left over, and ids of nothing
+    length = encode_frame(frame, sizeof(frame), f3, int32_t(1), int32_t(2));
+    TinyShell::CommandResult result = shell.run_binary(frame + 2, length - FRAME_OVERHEAD);
+    CHECK(result.status == TinyShell::COMMAND_CONVERSION_ERROR && result.failed_arg == 2);
+    length = encode_frame(frame, sizeof(frame), f3, int32_t(1), int32_t(2), int32_t(3), uint8_t(0));
+    CHECK(shell.run_binary(frame + 2, length - FRAME_OVERHEAD).status != TinyShell::COMMAND_OK);
+    length = encode_frame(frame, sizeof(frame), uint16_t(f3 + 2));
+    CHECK(shell.run_binary(frame + 2, length - FRAME_OVERHEAD).status == TinyShell::COMMAND_NOT_FOUND);
+    CHECK(shell.run_binary(frame + 2, 1).status != TinyShell::COMMAND_OK);
+}
+
+static vector<string> feed_lines(line_reader& reader, const string& text) {
+    vector<string> lines;
+    for (char c : text) {
+        if (!reader.feed(c)) continue;
+        lines.push_back(reader.overflowed() ? "!" : string(reader.get_line()));
+    }
+    return lines;
+}
+
+static void test_line_reader() {
+    line_reader reader;
+
+    // a line split across chunks is completed by the chunk with its end
+    CHECK(feed_lines(reader, "m -f3 1,").empty());
+    CHECK(feed_lines(reader, " 2, 3").empty());
+    CHECK(feed_lines(reader, "\r\nm -x\n") == vector<string>({"m -f3 1, 2, 3", "m -x"}));
+
+    // CR, LF and CRLF each end one line, a CRLF split between chunks too, an empty line is still a line
+    CHECK(feed_lines(reader, "a\rb\nc\r\nd\r") == vector<string>({"a", "b", "c", "d"}));
+    CHECK(feed_lines(reader, "\ne\n\n") == vector<string>({"e", ""}));
+
+    // backspace and delete take back characters of the line, never past its start
+    CHECK(feed_lines(reader, "\bab\x7f\bcd\n") == vector<string>({"cd"}));
+
+    // a line longer than the buffer is dropped whole, the next one is read again
+    string line(LINE_READER_SIZE, 'x');
+    CHECK(feed_lines(reader, line + "\n") == vector<string>({line}));
+    CHECK(feed_lines(reader, line + "y\b\nok\n") == vector<string>({"!", "ok"}));
+
+    // the echo shows what is kept of the line, backspaces and the ends of line
+    echoed.clear();
+    reader.set_echo(echo_to_string);
+    feed_lines(reader, "ab\bc\r\n");
+    CHECK(echoed == "ab\b \bc\r\n");
+    echoed.clear();
+    feed_lines(reader, line + "zz\n");
+    CHECK(echoed == line + "\r\n");
+    reader.set_echo(nullptr);
+    echoed.clear();
+    feed_lines(reader, "q\n");
+    CHECK(echoed.empty());
+
+    // through the shell the lines run, the long ones are reported
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+    shell.set_output(echo_to_string);
+    echoed.clear();
+    string input = "m -f3 1, 2, 3\r\n\r\n" + line + "y\n";
+    for (size_t i = 0; i < input.size(); i += 5) shell.feed(input.data() + i, min<size_t>(5, input.size() - i));
+    CHECK(echoed.find("m -f3") == string::npos);
+    CHECK(echoed.find("Line too long, dropped.\n") != string::npos);
+    shell.set_echo(true);
+    echoed.clear();
+    shell.feed("m -f3 1, 2, 3\n", 14);
+    CHECK(echoed.compare(0, 15, "m -f3 1, 2, 3\r\n") == 0);
+    shell.set_output(nullptr);
+}
+
+static atomic<uint32_t> async_done{0};
+static void on_done(uint32_t, const TinyShell::CommandResult&) { async_done++; }
+
+static void test_async() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+
+    // the errors found before queueing come back at once
+    uint32_t ticket = 0;
+    CHECK(shell.run_async("m -nope", 7, ticket).status == TinyShell::COMMAND_NOT_FOUND);
+    TinyShell::CommandResult bad = shell.run_async("m -f3 1, x, 3", 13, ticket);
+    CHECK(bad.status == TinyShell::COMMAND_CONVERSION_ERROR && bad.failed_arg == 1);
+
+    // without a worker the application pumps the queue, the tickets end in order
+    uint32_t first = 0, second = 0;
+    CHECK(shell.run_async("m -f3 1, 2, 3", 13, first, on_done).status == TinyShell::COMMAND_QUEUED);
+    CHECK(shell.run_async("m -f3 1, 2, 4", 13, second, on_done).status == TinyShell::COMMAND_QUEUED);
+    CHECK(second == first + 1);
+    CHECK(shell.poll_async(first).status == TinyShell::COMMAND_QUEUED);
+    CHECK(shell.process_async(1) == 1);
+    CHECK(shell.poll_async(first).status == TinyShell::COMMAND_OK);
+    CHECK(shell.poll_async(second).status == TinyShell::COMMAND_QUEUED);
+    CHECK(shell.process_async() == 1);
+    CHECK(shell.poll_async(second).status == TinyShell::COMMAND_FAILED);
+    CHECK(async_done == 2);
+
+    // a full queue runs nothing
+    size_t queued = 0;
+    uint32_t last = 0;
+    while (shell.run_async("m -f3 1, 2, 3", 13, ticket).status == TinyShell::COMMAND_QUEUED) {
+        last = ticket;
+        queued++;
+    }
+    CHECK(queued == ASYNC_QUEUE_SIZE);
+    CHECK(shell.process_async() == queued);
+    CHECK(shell.poll_async(last).status == TinyShell::COMMAND_OK);
+
+    // with a worker the commands end without the pump, the worker is the only consumer
+    async_done = 0;
+    CHECK(shell.start_worker());
+    for (int i = 0; i < 100; i++) {
+        while (shell.run_async("m -f3 1, 2, 3", 13, ticket, on_done).status == TinyShell::COMMAND_QUEUE_FULL) {}
+        CHECK(shell.process_async() == 0);
+    }
+    while (shell.poll_async(ticket).status == TinyShell::COMMAND_QUEUED) {}
+    CHECK(async_done == 100);
+    shell.stop_worker();
+
+    // started and stopped at once, and destroyed while the worker may still be starting
+    for (int i = 0; i < 50; i++) {
+        TinyShell other;
+        CHECK(other.start_worker());
+        CHECK(other.start_worker());
+        other.stop_worker();
+        CHECK(other.start_worker());
+    }
+}
+
+static void test_concurrent_registration() {
+    TinyShell shell(static_modules);
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+    uint16_t id = shell.get_command_id("m", "f3");
+    TinyShell::PreparedCommand prepared = shell.prepare("m -f3");
+
+    // another task registers while the lines, frames and prepared commands run
+    thread registrar([&shell] {
+        for (int i = 0; i < 200; i++) {
+            string module = "r" + to_string(i);
+            shell.create_module(module, "registered while running");
+            shell.add(add3, "f3", "sum of three", module);
+        }
+    });
+    uint8_t frame[32];
+    size_t length = encode_frame(frame, sizeof(frame), id, int32_t(1), int32_t(2), int32_t(3));
+    for (int i = 0; i < 2000; i++) {
+        CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+        CHECK(shell.run_command("s -s3 1, 2, 3").status == TinyShell::COMMAND_OK);
+        CHECK(shell.run_binary(frame + 2, length - FRAME_OVERHEAD).status == TinyShell::COMMAND_OK);
+        CHECK(prepared.run("1, 2, 3").status == TinyShell::COMMAND_OK);
+    }
+    registrar.join();
+    CHECK(shell.run_command("r199 -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(shell.get_command_id("r199", "f3") == id + 200);
+}
+
+// every chunk handed to the callback, to check where the sink cuts the text
+static vector<string> chunks;
+static void sink_to_chunks(void*, const char* text, size_t length) {
+    CHECK(text[length] == '\0');
+    chunks.push_back(string(text, length));
+}
+
+static void test_text_sink() {
+    // chunks of the buffer of the caller, one byte kept for the terminator
+    chunks.clear();
+    {
+        char buffer[5];
+        text_sink sink(sink_to_chunks, nullptr, buffer, sizeof(buffer));
+        sink.write("abcdef").write('g').write_number(12345).write("");
+        CHECK(sink.get_written() == 12);
+        CHECK(chunks == vector<string>({"abcd", "efg1"}));
+    }
+    CHECK(chunks == vector<string>({"abcd", "efg1", "2345"}));
+
+    // numbers of every size, and nothing is handed out for no text
+    string text;
+    {
+        text_sink sink(sink_to_string, &text);
+        sink.write_number(0).write(' ').write_number(UINT64_MAX);
+        sink.flush();
+        sink.flush();
+    }
+    CHECK(text == "0 18446744073709551615");
+    chunks.clear();
+    { text_sink sink(sink_to_chunks, nullptr); }
+    CHECK(chunks.empty());
+
+    // the shell streams the same text its string functions return
+    TinyShell shell(static_modules);
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+    const char* lines[] = {"m -f3 1, 2, 3", "m -f3 1, 2, 4", "q -f3", "m -nope", "m -f3 1, 2", "m -f3 1, x, 3", "s -x 1, 2.5, abc"};
+    for (const char* line : lines) {
+        text.clear();
+        {
+            text_sink sink(sink_to_string, &text);
+            shell.run_line_command(line, strlen(line), sink);
+        }
+        CHECK(text == shell.run_line_command(line));
+    }
+    text.clear();
+    {
+        text_sink sink(sink_to_string, &text);
+        shell.write_help(sink, "s");
+    }
+    CHECK(text == shell.get_help("s"));
+
+    // a mistyped command lists the commands of its module only
+    CHECK(shell.run_line_command("m -nope").find("s3") == string::npos);
+}
+
+static void test_name_pool() {
+    name_pool pool;
+    const char* a = pool.intern("alpha");
+    CHECK(strcmp(a, "alpha") == 0 && pool.get_used() == 6);
+
+    // equal names share one copy, a view that is not null terminated too
+    string_view text("alphabet");
+    CHECK(pool.intern(text.substr(0, 5)) == a && pool.get_used() == 6);
+    CHECK(strcmp(pool.intern(text), "alphabet") == 0 && pool.intern(text) != a);
+
+    // the names never move while the blocks and the set grow, a name longer than a block too
+    vector<const char*> names;
+    for (int i = 0; i < 1000; i++) names.push_back(pool.intern("name" + to_string(i)));
+    string long_name(NAME_POOL_BLOCK * 2, 'n');
+    const char* long_copy = pool.intern(long_name);
+    CHECK(long_copy == pool.intern(long_name) && long_name == long_copy);
+    for (int i = 0; i < 1000; i++) CHECK(names[i] == pool.intern("name" + to_string(i)));
+    CHECK(pool.intern("alpha") == a);
+
+    // the shell keeps the names it is given, not the caller's strings
+    TinyShell shell;
+    {
+        string module = "temporary";
+        string command = "f3";
+        shell.create_module(module, "test module");
+        shell.add(add3, command, "sum of three", module);
+        module.assign(module.size(), '?');
+        command.assign(command.size(), '?');
+    }
+    CHECK(succeeds(shell, "temporary -f3 1, 2, 3"));
+    CHECK(shell.get_help("temporary") == "temporary: test module\n-f3 (i4, i4, i4) => sum of three\n");
+}
+
+static void test_array_args() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(sum, "sum", "sum of an array", "m");
+
+    // the commas inside the brackets separate items, not arguments
+    CHECK(shell.run_command("m -sum [1, 2, 3], 6").status == TinyShell::COMMAND_OK);
+    CHECK(shell.run_command("m -sum [1 2 3],6").status == TinyShell::COMMAND_OK);
+    CHECK(shell.run_command("m -sum  [ 1,2 ,3 ] , 6 ").status == TinyShell::COMMAND_OK);
+    CHECK(shell.run_command("m -sum [], 0").status == TinyShell::COMMAND_OK);
+    CHECK(shell.run_command("m -sum [1, 2, 3]").status == TinyShell::COMMAND_WRONG_ARG_COUNT);
+
+    // a bad item fails the array, reported as its argument
+    TinyShell::CommandResult bad = shell.run_command("m -sum [1, x, 3], 4");
+    CHECK(bad.status == TinyShell::COMMAND_CONVERSION_ERROR && bad.failed_arg == 0);
+    CHECK(shell.format_result("m -sum [1, x, 3], 4", bad) == "Error converting argument '[1, x, 3]' to type 'i4[]'");
+
+    // without its bracket the commas split the array into arguments
+    CHECK(shell.run_command("m -sum [1, 2, 3, 6").status == TinyShell::COMMAND_WRONG_ARG_COUNT);
+    bad = shell.run_command("m -sum [1 2 3, 6");
+    CHECK(bad.status == TinyShell::COMMAND_CONVERSION_ERROR && bad.failed_arg == 0);
+
+    // the same through the cache and a prepared command
+    shell.enable_cache(2);
+    CHECK(shell.run_command("m -sum [1, 2, 3], 6").status == TinyShell::COMMAND_OK);
+    CHECK(shell.run_command("m -sum [1, 2, 3], 6").status == TinyShell::COMMAND_OK);
+    CHECK(shell.get_cache().get_hits() == 1);
+    CHECK(shell.prepare("m -sum").run("[4, 5], 9").status == TinyShell::COMMAND_OK);
+}
+
+static void test_format_result() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+
+    TinyShell::CommandResult count = {TinyShell::COMMAND_WRONG_ARG_COUNT, RESULT_ERROR, 0};
+    TinyShell::CommandResult conversion = {TinyShell::COMMAND_CONVERSION_ERROR, RESULT_ERROR, 1};
+
+    // the line resolves, the types come from the command
+    CHECK(shell.format_result("m -f3 1", count) == "(i4, i4, i4)");
+    CHECK(shell.format_result("m -f3 1, x, 3", conversion) == "Error converting argument 'x' to type 'i4'");
+
+    // the line does not resolve, or there is no line at all
+    CHECK(shell.format_result("m -gone 1", count) == "Wrong number of arguments");
+    CHECK(shell.format_result("m -gone 1, x", conversion) == "Error converting argument 'x'");
+    CHECK(shell.format_result("", conversion) == "Error converting argument 1");
+
+    // an index past the parameters of the command
+    TinyShell::CommandResult past = {TinyShell::COMMAND_CONVERSION_ERROR, RESULT_ERROR, 7};
+    CHECK(shell.format_result("m -f3 1, 2, 3", past) == "Error converting argument ''");
+
+    // the same results, from real lines
+    CHECK(shell.run_line_command("m -f3 1") == "(i4, i4, i4)");
+    CHECK(shell.run_line_command("m -f3 1, 2, 3").find("sucesso") != string::npos);
+}
+
+static void test_invalid_handle() {
+    command_handle handle;
+    CHECK(!handle.valid());
+    CHECK(handle.get_size() == 0);
+    CHECK(handle.get_param_types() == nullptr);
+    CHECK(handle.get_name().empty());
+    CHECK(handle.call() == FUNCTION_NOT_FOUND);
+
+    uint8_t code = 0;
+    size_t failed_arg = 9;
+    CHECK(!handle.parse_call("1", code, failed_arg));
+    CHECK(code == FUNCTION_NOT_FOUND && failed_arg == 0);
+}
+
+static void test_run_line() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "add3", "sum of three", "m");
+
+    // the types of the command outlive every line
+    CHECK(succeeds(shell, "m -add3 1, 2, 3"));
+    CHECK(succeeds(shell, "m -add3 1, 2, 3"));
+    CHECK(shell.run_line_command("m -add3 1, 2, 4").find("255") != string::npos);
+    CHECK(shell.run_line_command("m -nope").find("not found") != string::npos);
+    CHECK(shell.run_line_command("x -add3 1, 2, 3").find("not found") != string::npos);
+}
+
+static void test_parse_args() {
+    // the limits of each integer type, and one past them
+    CHECK(parses<uint8_t>("255", 255) && rejects<uint8_t>("256") && rejects<uint8_t>("-1"));
+    CHECK(parses<int8_t>("-128", -128) && parses<int8_t>("127", 127));
+    CHECK(rejects<int8_t>("-129") && rejects<int8_t>("128"));
+    CHECK(parses<int32_t>("-2147483648", INT32_MIN) && rejects<int32_t>("2147483648"));
+    CHECK(parses<uint32_t>("4294967295", UINT32_MAX) && rejects<uint32_t>("4294967296"));
+    CHECK(parses<int64_t>("-9223372036854775808", INT64_MIN) && parses<int64_t>("9223372036854775807", INT64_MAX));
+    CHECK(rejects<int64_t>("9223372036854775808") && rejects<int64_t>("-9223372036854775809"));
+    CHECK(parses<uint64_t>("18446744073709551615", UINT64_MAX) && rejects<uint64_t>("18446744073709551616"));
+    CHECK(rejects<uint64_t>("99999999999999999999999"));
+
+    // signs, and nothing but the number
+    CHECK(parses<int32_t>("+7", 7) && parses<int32_t>("-0", 0) && parses<uint32_t>("+7", 7u));
+    CHECK(rejects<int32_t>("") && rejects<int32_t>("-") && rejects<int32_t>("+-1") && rejects<int32_t>("--1"));
+    CHECK(rejects<int32_t>("12x") && rejects<int32_t>("1 2") && rejects<int32_t>("0x10") && rejects<int32_t>("1.5"));
+
+    // floating point, finite values only
+    CHECK(parses<double>("1.5", 1.5) && parses<double>("-2e3", -2000.0) && parses<double>("+.5", 0.5));
+    CHECK(parses<float>("0.25", 0.25f) && rejects<float>("1e39") && rejects<double>("1e400"));
+    CHECK(rejects<double>("inf") && rejects<double>("-inf") && rejects<double>("nan") && rejects<float>("infinity"));
+    CHECK(rejects<double>("") && rejects<double>("1.5x") && rejects<double>("e5") && rejects<double>("+-1"));
+
+    // one character exactly, and the words of a bool
+    CHECK(parses<char>("a", 'a') && rejects<char>("") && rejects<char>("ab"));
+    CHECK(parses<bool>("true", true) && parses<bool>("0", false) && rejects<bool>("yes") && rejects<bool>("2"));
+
+    // a bad number is a conversion error of its argument
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+    TinyShell::CommandResult result = shell.run_command("m -f3 1, 2x, 3");
+    CHECK(result.status == TinyShell::COMMAND_CONVERSION_ERROR && result.failed_arg == 1);
+}
+
+static void test_parse_command() {
+    TinyShell::ParsedCommand cmd = TinyShell::parse_command(" mod -cmd 1, 2,3 \r\n");
+    CHECK(cmd.module_name == "mod" && cmd.command_name == "cmd");
+    CHECK(cmd.args_str == "1, 2,3" && cmd.args_count == 3);
+
+    cmd = TinyShell::parse_command("mod -cmd");
+    CHECK(cmd.command_name == "cmd" && cmd.args_str.empty() && cmd.args_count == 0);
+    cmd = TinyShell::parse_command("mod");
+    CHECK(cmd.module_name == "mod" && cmd.command_name.empty() && cmd.args_count == 0);
+    cmd = TinyShell::parse_command("");
+    CHECK(cmd.module_name.empty() && cmd.command_name.empty());
+}
+
+static void test_parse_line() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(mixed, "mixed", "mixed types", "m");
+
+    // whitespace and line endings around the line and the arguments
+    CHECK(succeeds(shell, "m -mixed 1, 2.5, abc"));
+    CHECK(succeeds(shell, "  m -mixed 1,2.5,abc \r\n"));
+    CHECK(succeeds(shell, "\tm -mixed 1, 2.5, abc\n"));
+    CHECK(shell.run_line_command("m -mixed 1, 2.5, abd").find("7") != string::npos);
+    CHECK(shell.run_line_command("m -mixed 1, 2.5").find("(u1, f8, s0)") != string::npos);
+
+    // a buffer that is not null terminated, only 'length' bytes are the line
+    const char buffer[] = "m -mixed 1, 2.5, abcdef";
+    CHECK(shell.run_line_command(buffer, sizeof(buffer) - 4).find("sucesso") != string::npos);
+    CHECK(shell.run_line_command(buffer, sizeof(buffer) - 1).find("7") != string::npos);
+
+    // the argument that failed is reported with its type
+    shell.add(unsupported, "wide", "a type without parser", "m");
+    CHECK(shell.run_line_command("m -wide 1, 22").find("'22'") != string::npos);
+}
+
+static void test_command_ids() {
+    // the first command of the application takes id 0, with or without the built-in stats module
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+    CHECK(shell.get_command_id("m", "f3") == 0);
+    CHECK(shell.get_command_id("stats", "l") == COMMAND_ID_NONE);
+}
+
+#ifdef TINY_SHELL_STATS
+static void test_stats() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+    shell.add(mixed, "x", "mixed types", "m");
+    shell.set_output(echo_to_string);
+
+    // failed calls count too, commands that never ran are not listed
+    CHECK(succeeds(shell, "m -f3 1, 2, 3"));
+    CHECK(!succeeds(shell, "m -f3 1, 2, 4"));
+    string stats = shell.get_stats();
+    CHECK(stats.find("m -f3: calls=2 ") != string::npos && stats.find("m -x:") == string::npos);
+
+    // listed and reset by the built-in module
+    echoed.clear();
+    CHECK(succeeds(shell, "stats -l"));
+    CHECK(echoed.find("m -f3: calls=2 ") != string::npos);
+    CHECK(succeeds(shell, "stats -r"));
+    CHECK(shell.get_stats().find("m -f3: calls=2 ") == string::npos);
+}
+
+static void test_stats_paths() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+    command_stats& stats = shell.get_table().resolve("m", "f3").get_stats();
+
+    // every way to run a command counts its phases
+    TinyShell::PreparedCommand prepared = shell.prepare("m -f3");
+    CHECK(prepared.run("1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(stats.calls == 1 && stats.parse.count == 1 && stats.convert.count == 1 && stats.execute.count == 1);
+
+    uint8_t payload[] = {0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0};
+    CHECK(shell.run_binary(payload, sizeof(payload)).status == TinyShell::COMMAND_OK);
+    CHECK(stats.calls == 2 && stats.parse.count == 2 && stats.convert.count == 2 && stats.execute.count == 2);
+
+    // through the cache a hit has nothing to convert
+    shell.enable_cache(2);
+    CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(shell.run_command("m -f3 1, 2, 3").status == TinyShell::COMMAND_OK);
+    CHECK(stats.calls == 4 && stats.parse.count == 4 && stats.convert.count == 3 && stats.execute.count == 4);
+}
+
+static void test_concurrent_stats() {
+    TinyShell shell;
+    shell.create_module("m", "test module");
+    shell.add(add3, "f3", "sum of three", "m");
+
+    // every call from every thread is counted
+    vector<thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&shell] { for (int i = 0; i < 1000; i++) shell.run_command("m -f3 1, 2, 3"); });
+    for (thread& worker : threads) worker.join();
+    CHECK(shell.get_stats().find("m -f3: calls=4000 ") != string::npos);
+}
+#endif
+
+int main() {
+    test_command_index();
+    test_command_handle();
+    test_arg_arena();
+    test_converters();
+    test_parse_call();
+    test_callables();
+    test_table_growth();
+    test_static_table();
+    test_run_command();
+    test_run_script();
+    test_command_cache();
+    test_cache_registration();
+    test_attach_static();
+    test_prepared_command();
+    test_run_binary();
+    test_line_reader();
+    test_async();
+    test_concurrent_registration();
+    test_text_sink();
+    test_name_pool();
+    test_array_args();
+    test_format_result();
+    test_invalid_handle();
+    test_command_ids();
+    test_run_line();
+    test_parse_args();
+    test_parse_command();
+    test_parse_line();
+#ifdef TINY_SHELL_STATS
+    test_stats();
+    test_stats_paths();
+    test_concurrent_stats();
+#endif
+    printf("tinyshell_test: ok\n");
+    return 0;
+}